@@ -1,184 +1,804 @@
-#include<stdlib.h>
-#include<stdio.h>
-#include "537malloc.h"
-#include "range_tree.h"
-
-/*This is a c library including functions malloc537, free537, memcheck537 and realloc537.*/
-
-static RBRoot *root;
-static int counter = 0;
-static int freeSignal = 1; //1 when free537; 0 when realloc537
-
-
-/*
-In addition to actually allocating the memory by calling malloc(), this function will record a tuple (addri, leni), for the memory that you allocate in the heap. (If the allocated memory was previously freed, this will be a bit more complicated.) You will get the starting address, addri, from the return value from malloc() and the length, leni, from the size parameter. You can check the size parameter for zero length (this is not actually an error, but unusual enough that it is worth reporting).
-
-*/
-void *malloc537(int size){
-    Node* ret;
-    if (size < 0) {
-        fprintf(stderr,"Error: cannot assign negative size");
-	exit(-1);
-    }
-    if (size == 0) {
-	printf("Warning! Trying to malloc 0 size!\n");
-    }
-    //initialize the root of the tree is malloc is first called
-    if(!counter){
-        root = create_rbtree();
-        counter = 1;    
-    }
-    
-    //exit if malloc failed
-    if ((ret = insert_rbtree(root, size, NULL)) == NULL){
-        fprintf(stderr, "Error: No space for malloc\n");
-        exit(-1);
-    }
-    //return the starting addr for the malloc block
-    else{ 
-        return ret->start;
-    }
-}
-
-/*
-This function will first check to make sure that freeing the memory specified by ptr makes sense, then will call free() to do the actual free. Some of the error conditions that you should check for include:
-Freeing memory that has not be allocated with malloc537().
-Freeing memory that is not the first byte of the range of memory that was allocated.
-Freeing memory that was previously freed (double free).
-When an error is detected, then print out a detailed and informative error message and exit the program (with a -1 status). If all checks pass,then this function indicates that the tuple for addr = ptr is no longer allocated, and then calls free().
-
-*/
-void free537(void *ptr){
-    //exit if NULL pointer passed in
-    if (ptr == NULL){
-        fprintf(stderr, "Error: cannot free NULL pointer\n");
-        exit(-1);
-    }
-    Node* node = root->node;
-   
-    //search the tree
-    while(node != NULL){
-    	//if find the node we need to free 
-        if (ptr == node->start){
-        	//Double free occures
-        	if (node->freeFlag == 0){
-        		fprintf(stderr, "Error: Freeing memory that was previously "
-        			"freed (double free)\n");
-        	    exit(-1);
-        	}
-        	//set freeFlag of the node to 0 
-        	else{
-        		node->freeFlag = 0;
-			if (freeSignal == 1)                	
-				free(ptr);
-        		return;
-        	}
-     	}
-     	
-        //otherwise keep searching the tree
-     	else{
-     		//target free node's addr is lower than current node
-        	if(ptr < node->start){
-        		node = node->left;
-        	}
-        	//target free node's addr is higher than current node
-        	else if(ptr > (node->start + node->size -1)){
-        		node = node->right;
-        	}
-        	//target free node's addr is within current node 
-        	else{
-        		fprintf(stderr, "Error: Freeing memory is not the first byte "
-        		 "of the range of memory that was allocated.\n");
-        		exit(-1);
-        	}
-     	}
-   	}
-
-    //serach the whole tree but cannot find target free addr
-    	fprintf(stderr, "Error: Freeing memory that has not be allocated" 
-    		" with malloc537().\n");
-        exit(-1);
-
-}
-
-
-/*
-If ptr is NULL,then this follows the specification of malloc537() above. If size is zero and ptr is not NULL,then this follows the specification of free537() above. Otherwise, in addition to changing the memory allocation by calling realloc(), this function will first check to see if there was a tuple for the (addr = ptr, and removes that tuple, then adds a new one where addr is the return value from realloc() and len is size
-
-*/
-
-void *realloc537(void *ptr, int size){
-    if (ptr == NULL) {
-        return malloc537(size);
-    }
-    else {
-	freeSignal = 0;
-        free537(ptr);
-	freeSignal = 1;
-        if (size == 0) {
-	    printf("Warning! Trying to realloc 0 size! \n");
-	}
-  	void *a = realloc(ptr, size);
-	return insert_rbtree(root, size, a)->start;
-    }
-}
-
-
-/*
-This function checks to see the address range specified by address ptr and length size are fully within a range allocated by malloc537() and memory not yet freed by free537(). When an error is detected, then print out a detailed and informative error message and exit the program (with a -1 status). 
-*/
-void memcheck537(void *ptr, int size){
-    //signal if ptr is found
-    int success = 0;
-    //exit if NULL pointer passed in
-    if (ptr == NULL){
-        fprintf(stderr, "Error: cannot check memory space for NULL pointer\n");
-        exit(-1);
-    }
-    Node* node = root->node;
-    //search the whole tree
-    while(node!=NULL){
-        //target addr is smaller than current block's starting addr
-        if (ptr < node->start){
-            node = node->left;
-        }
-        //target addr is bigger than current block's ending addr
-        else if (ptr > (node->start + node->size -1)){
-            node = node->right;
-        }
-        //target addr is within the current block's addr 
-        else{
-            //ptr is found within the allocated block
-            success = 1;
-            //error if the current block has been freed
-            if (node->freeFlag == 0){
-                fprintf(stderr, "Error: The checking memory space has been freed\n");
-                exit(-1);
-            }else{  //determine if the size of searching mem is larger than current block's ending addr
-                if ((ptr + size -1) > (node->start + node->size -1)){
-                    fprintf(stderr,"Error: The checking memory space beyond the boundry\n");
-                    exit(-1);
-                }
-                else{ 
-                    printf("The checking memory space has been allocated\n");
-                    break;
-                }
-            }
-        }
-    }
-
-    //serach the whole tree but cannot find checking memory space
-    if (!success){
-       fprintf(stderr, "Error: The checking memory space has not been allocated\n");
-       exit(-1);
-    }
-
-}
-
-
-
-
-
-void printEverything(){
-    print_rbtree(root);
-}   
+#include<stdlib.h>
+#include<stdio.h>
+#include<stdarg.h>
+#include<string.h>
+#include<errno.h>
+#include<unistd.h>
+#include<stdint.h>
+//the library itself always has the full checks, whatever the level of its callers
+#undef MALLOC537_CHECK_LEVEL
+#define MALLOC537_CHECK_LEVEL 2
+#include "537malloc.h"
+#include "range_tree.h"
+#ifdef SLAB537
+#include "slab537.h"
+#endif
+#ifdef TRACE537
+#include<fcntl.h>
+#include<pthread.h>
+#include<time.h>
+#include "trace537.h"
+#endif
+
+/*This is a c library including functions malloc537, free537, memcheck537 and realloc537.*/
+
+static RBRoot *root;
+static int counter = 0;
+static int freeSignal = 1; //1 when free537; 0 when realloc537
+
+/*Blocks of the last two successful range checks, so the two operands of a
+ copy, or a loop over one buffer, usually skip the tree search. Only
+ allocated nodes are kept here and an insert is the only thing that deletes
+ nodes (freed ones, in nodeoverlap), so every insert clears the cache.*/
+static Node *hits[2];
+static int nextHit = 0;
+
+//number of size classes in the leak report: class 0 holds 0 size blocks,
+//class k holds sizes in [2^(k-1), 2^k - 1]
+#define LEAK_CLASSES (8 * sizeof(size_t) + 1)
+
+/*A buffered writer on a file descriptor, so a report is written with a few
+ write() calls instead of one stdio call per line*/
+typedef struct writer{
+    int fd;
+    size_t len;
+    char buf[4096];
+}writer;
+
+static void writer_flush(writer *w){
+    size_t done = 0;
+    while (done < w->len) {
+        ssize_t n = write(w->fd, w->buf + done, w->len - done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;    //nothing sensible left to do with a broken fd at exit
+        }
+        done += n;
+    }
+    w->len = 0;
+}
+
+static void writer_printf(writer *w, const char *fmt, ...){
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, ap);
+    va_end(ap);
+    //did not fit: flush what we have and format again into the empty buffer
+    if (n >= 0 && (size_t)n >= sizeof(w->buf) - w->len) {
+        writer_flush(w);
+        va_start(ap, fmt);
+        n = vsnprintf(w->buf, sizeof(w->buf), fmt, ap);
+        va_end(ap);
+        if ((size_t)n >= sizeof(w->buf))
+            n = sizeof(w->buf) - 1;
+    }
+    if (n > 0)
+        w->len += n;
+}
+
+//size class of a block in the leak report
+static int leak_class(size_t size){
+    if (size == 0)
+        return 0;
+    return 8 * sizeof(unsigned long) - __builtin_clzl(size);
+}
+
+//leaked blocks per size class
+typedef struct leaks{
+    unsigned long count[LEAK_CLASSES];
+    unsigned long long bytes[LEAK_CLASSES];
+}leaks;
+
+static void count_leak(void *start, size_t size, void *arg){
+    leaks *l = arg;
+    int c = leak_class(size);
+
+    (void)start;
+    l->count[c]++;
+    l->bytes[c] += size;
+}
+
+/*
+Registered with atexit() when the tree is created. Walks the tree in address order through the parent pointers (no recursion, no allocation) and reports every block still allocated, meaning freeFlag is 1, aggregated by size class. Nothing is printed when there is no leak.
+*/
+static void report_leaks(void){
+    leaks l = {{0}, {0}};
+    unsigned long *count = l.count;
+    unsigned long long *bytes = l.bytes;
+    unsigned long total = 0;
+    unsigned long long totalBytes = 0;
+    writer w;
+    Node *node;
+    unsigned int i;
+
+    for (node = rbtree_first(root); node != NULL; node = rbtree_next(node)) {
+        if (node->freeFlag == 1)
+            count_leak(node->start, node->size, &l);
+    }
+#ifdef SLAB537
+    slab_walk(count_leak, &l);
+#endif
+    for (i = 0; i < LEAK_CLASSES; i++) {
+        total += count[i];
+        totalBytes += bytes[i];
+    }
+    if (total == 0)
+        return;
+
+    w.fd = STDERR_FILENO;
+    w.len = 0;
+    writer_printf(&w, "Warning: %lu blocks (%llu bytes) allocated with malloc537() "
+        "were never freed\n", total, totalBytes);
+    for (i = 0; i < LEAK_CLASSES; i++) {
+        if (count[i] == 0)
+            continue;
+        if (i == 0)
+            writer_printf(&w, "    size 0: %lu blocks\n", count[i]);
+        else
+            writer_printf(&w, "    size %zu-%zu: %lu blocks, %llu bytes\n",
+                (size_t)1 << (i - 1), ((size_t)2 << (i - 1)) - 1, count[i], bytes[i]);
+    }
+    writer_flush(&w);
+}
+
+
+#ifdef TRACE537
+/*Allocation trace recorder, compiled in with -DTRACE537 and switched on at
+ run time by setting MALLOC537_TRACE to the output file name. Every thread
+ collects events in its own buffer and appends the whole buffer to the file
+ when it fills up, when the thread exits and, for the thread calling exit(),
+ at exit. Buffers of threads that are still running at exit are lost.*/
+
+//events per thread buffer
+#define TRACE_EVENTS 4096
+
+typedef struct tracebuf{
+    uint32_t thread;
+    int len;
+    trace537_event ev[TRACE_EVENTS];
+}tracebuf;
+
+static int traceFd = -1;
+static uint32_t traceThreads = 0;
+static pthread_once_t traceOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t traceKey;
+static __thread tracebuf *traceBuf;
+
+static void trace_flush(tracebuf *tb){
+    const char *p = (const char *)tb->ev;
+    size_t left = tb->len * sizeof(trace537_event);
+
+    while (left > 0) {
+        ssize_t n = write(traceFd, p, left);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Error: cannot write allocation trace, tracing stopped\n");
+            traceFd = -1;
+            break;
+        }
+        p += n;
+        left -= n;
+    }
+    tb->len = 0;
+}
+
+//pthread key destructor, flushes and frees the buffer of an exiting thread
+static void trace_thread_exit(void *arg){
+    tracebuf *tb = arg;
+    if (traceFd >= 0)
+        trace_flush(tb);
+    free(tb);
+}
+
+static void trace_exit(void){
+    if (traceBuf != NULL && traceFd >= 0)
+        trace_flush(traceBuf);
+}
+
+static void trace_open(void){
+    trace537_header hdr;
+    const char *path = getenv("MALLOC537_TRACE");
+
+    if (path == NULL || *path == '\0')
+        return;
+    if ((traceFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644)) < 0) {
+        fprintf(stderr, "Error: cannot open allocation trace file %s\n", path);
+        return;
+    }
+    memcpy(hdr.magic, TRACE537_MAGIC, sizeof(hdr.magic));
+    hdr.version = TRACE537_VERSION;
+    hdr.event_size = sizeof(trace537_event);
+    if (write(traceFd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        fprintf(stderr, "Error: cannot write allocation trace file %s\n", path);
+        close(traceFd);
+        traceFd = -1;
+        return;
+    }
+    pthread_key_create(&traceKey, trace_thread_exit);
+    atexit(trace_exit);
+}
+
+static void trace_record(int op, uintptr_t ptr, uintptr_t ret, size_t size){
+    tracebuf *tb = traceBuf;
+    trace537_event *e;
+    struct timespec ts;
+
+    pthread_once(&traceOnce, trace_open);
+    if (traceFd < 0)
+        return;
+    if (tb == NULL) {
+        if ((tb = malloc(sizeof(tracebuf))) == NULL)
+            return;
+        tb->thread = __atomic_fetch_add(&traceThreads, 1, __ATOMIC_RELAXED);
+        tb->len = 0;
+        traceBuf = tb;
+        pthread_setspecific(traceKey, tb);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    e = &tb->ev[tb->len++];
+    e->op = op;
+    e->pad[0] = e->pad[1] = e->pad[2] = 0;
+    e->thread = tb->thread;
+    e->ptr = ptr;
+    e->ret = ret;
+    e->size = size;
+    e->ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    if (tb->len == TRACE_EVENTS)
+        trace_flush(tb);
+}
+
+#define TRACE(op, ptr, ret, size) \
+    trace_record(TRACE537_##op, (uintptr_t)(ptr), (uintptr_t)(ret), (size))
+#else
+#define TRACE(op, ptr, ret, size) do { (void)(ptr); (void)(ret); } while (0)
+#endif
+
+
+/*Open scopes, innermost first. The blocks of a scope are kept in a list
+ linked through their tree nodes (scope_next, scope_pprev), so leaving a
+ scope needs no tree search, and free537 can unlink a block in O(1).*/
+typedef struct scope{
+    Node *head;
+    struct scope *outer;
+}scope;
+
+static scope *scopes = NULL;
+
+//scope position of the block free537 unlinked last, for realloc537; NULL if it was in no scope
+static Node **freedLink = NULL;
+
+//where a new block goes: the head of the innermost open scope, NULL if there is none
+static Node **scope_head(void){
+    return scopes != NULL ? &scopes->head : NULL;
+}
+
+//link a block into a scope list at link, the head of a scope or the scope_next of one of its blocks; NULL links nothing
+static void scope_link(Node *node, Node **link){
+    if (link == NULL)
+        return;
+    node->scope_next = *link;
+    if (*link != NULL)
+        (*link)->scope_pprev = &node->scope_next;
+    *link = node;
+    node->scope_pprev = link;
+}
+
+//unlink a block that is freed before its scope ends
+static void scope_remove(Node *node){
+    if (node->scope_pprev == NULL)
+        return;
+    *node->scope_pprev = node->scope_next;
+    if (node->scope_next != NULL)
+        node->scope_next->scope_pprev = node->scope_pprev;
+    node->scope_next = NULL;
+    node->scope_pprev = NULL;
+}
+
+
+//initialize the root of the tree when the library is first used
+static void init537(void){
+    if(!counter){
+        root = create_rbtree();
+        counter = 1;    
+        atexit(report_leaks);
+    }
+}
+
+//size checks shared by the allocation functions; a size above PTRDIFF_MAX is a negative int that got converted
+static void check_size(size_t size, const char *who){
+    if (size > PTRDIFF_MAX) {
+        fprintf(stderr,"Error: cannot assign negative size %td with %s537\n", (ptrdiff_t)size, who);
+	exit(-1);
+    }
+    if (size == 0) {
+	printf("Warning! Trying to %s 0 size!\n", who);
+    }
+}
+
+//record memory that was obtained from libc as an allocated block, linked into a scope at link (see scope_link)
+static Node* track(void *ptr, size_t size, Node **link){
+    Node *node;
+
+    hits[0] = hits[1] = NULL;
+    if (ptr == NULL || (node = insert_rbtree(root, size, ptr)) == NULL){
+        fprintf(stderr, "Error: No space for malloc\n");
+        exit(-1);
+    }
+    scope_link(node, link);
+    return node;
+}
+
+#ifdef SLAB537
+/*
+Check that ptr is the first byte of an allocated slab block, with the error messages of free537. Returns 0 if ptr is in no slab block, so the tree has to be searched, and 1 with the block in blk otherwise.
+*/
+static int slab_check_free(void *ptr, SlabBlock *blk){
+    switch (slab_lookup(ptr, blk)) {
+    case SLAB_NONE:
+        return 0;
+    case SLAB_CORRUPT:
+        fprintf(stderr, "Error: The header of the block at %p has been overwritten\n", blk->start);
+        exit(-1);
+    case SLAB_FREED:
+        if (ptr == blk->start) {
+            fprintf(stderr, "Error: Freeing memory that was previously "
+                "freed (double free)\n");
+            exit(-1);
+        }
+        break;
+    }
+    if (ptr != blk->start) {
+        fprintf(stderr, "Error: Freeing memory is not the first byte "
+            "of the range of memory that was allocated.\n");
+        exit(-1);
+    }
+    return 1;
+}
+#endif
+
+//allocate and record a block, without the size checks and the trace of malloc537; link as for track
+static void *alloc537(size_t size, Node **link){
+#ifdef SLAB537
+    void *p;
+
+    //blocks of a scope go to the tree, where the scope lists are
+    if (size <= SLAB_MAX && link == NULL) {
+        if ((p = slab_alloc(size)) == NULL) {
+            fprintf(stderr, "Error: No space for malloc\n");
+            exit(-1);
+        }
+        return p;
+    }
+#endif
+    //track exits if malloc failed
+    return track(malloc(size), size, link)->start;
+}
+
+/*
+In addition to actually allocating the memory by calling malloc(), this function will record a tuple (addri, leni), for the memory that you allocate in the heap. (If the allocated memory was previously freed, this will be a bit more complicated.) You will get the starting address, addri, from the return value from malloc() and the length, leni, from the size parameter. You can check the size parameter for zero length (this is not actually an error, but unusual enough that it is worth reporting).
+
+*/
+void *malloc537(size_t size){
+    void *ret;
+    check_size(size, "malloc");
+    init537();
+    
+    ret = alloc537(size, scope_head());
+    TRACE(MALLOC, NULL, ret, size);
+    //return the starting addr for the malloc block
+    return ret;
+}
+
+/*
+This function will first check to make sure that freeing the memory specified by ptr makes sense, then will call free() to do the actual free. Some of the error conditions that you should check for include:
+Freeing memory that has not be allocated with malloc537().
+Freeing memory that is not the first byte of the range of memory that was allocated.
+Freeing memory that was previously freed (double free).
+When an error is detected, then print out a detailed and informative error message and exit the program (with a -1 status). If all checks pass,then this function indicates that the tuple for addr = ptr is no longer allocated, and then calls free().
+
+*/
+void free537(void *ptr){
+    //exit if NULL pointer passed in
+    if (ptr == NULL){
+        fprintf(stderr, "Error: cannot free NULL pointer\n");
+        exit(-1);
+    }
+#ifdef SLAB537
+    //small blocks are checked with their header, no tree search
+    SlabBlock blk;
+    if (slab_check_free(ptr, &blk)) {
+        TRACE(FREE, ptr, NULL, 0);
+        slab_free(ptr);
+        return;
+    }
+#endif
+    Node* node = counter ? root->node : NULL;
+   
+    //search the tree
+    while(node != NULL){
+    	//if find the node we need to free 
+        if (ptr == node->start){
+        	//Double free occures
+        	if (node->freeFlag == 0){
+        		fprintf(stderr, "Error: Freeing memory that was previously "
+        			"freed (double free)\n");
+        	    exit(-1);
+        	}
+        	//set freeFlag of the node to 0 
+        	else{
+        		node->freeFlag = 0;
+        		if (freeSignal == 0)
+        			freedLink = node->scope_pprev;
+        		scope_remove(node);
+        		node->free_epoch = ++root->epoch;   //after scope_remove, it shares the bytes of the scope links
+			if (freeSignal == 1) {
+				TRACE(FREE, ptr, NULL, 0);
+				free(ptr);
+			}
+        		return;
+        	}
+     	}
+     	
+        //otherwise keep searching the tree
+     	else{
+     		//target free node's addr is lower than current node
+        	if(ptr < node->start){
+        		node = node->left;
+        	}
+        	//target free node's addr is higher than current node
+        	else if(ptr > (node->start + node->size -1)){
+        		node = node->right;
+        	}
+        	//target free node's addr is within current node 
+        	else{
+        		fprintf(stderr, "Error: Freeing memory is not the first byte "
+        		 "of the range of memory that was allocated.\n");
+        		exit(-1);
+        	}
+     	}
+   	}
+
+    //serach the whole tree but cannot find target free addr
+    	fprintf(stderr, "Error: Freeing memory that has not be allocated" 
+    		" with malloc537().\n");
+        exit(-1);
+
+}
+
+
+/*
+If ptr is NULL,then this follows the specification of malloc537() above. If size is zero and ptr is not NULL,then this follows the specification of free537() above. Otherwise, in addition to changing the memory allocation by calling realloc(), this function will first check to see if there was a tuple for the (addr = ptr, and removes that tuple, then adds a new one where addr is the return value from realloc() and len is size
+
+*/
+
+void *realloc537(void *ptr, size_t size){
+    if (ptr == NULL) {
+        return malloc537(size);
+    }
+    else {
+	uintptr_t old = (uintptr_t)ptr;    //ptr must not be touched after realloc(), keep it for the trace
+	if (size > PTRDIFF_MAX) {
+	    fprintf(stderr,"Error: cannot assign negative size %td with realloc537\n", (ptrdiff_t)size);
+	    exit(-1);
+	}
+        //follows free537; realloc() would free the block and return NULL, which is no out of memory
+        if (size == 0) {
+	    printf("Warning! Trying to realloc 0 size! \n");
+	    free537(ptr);
+	    return NULL;
+	}
+#ifdef SLAB537
+	//a slab block moves to a new block of the right size class, or to the tree; it was in no scope
+	SlabBlock blk;
+	if (slab_check_free(ptr, &blk)) {
+	    void *a = alloc537(size, NULL);
+	    memcpy(a, ptr, blk.size < size ? blk.size : size);
+	    slab_free(ptr);
+	    TRACE(REALLOC, old, a, size);
+	    return a;
+	}
+#endif
+	freeSignal = 0;
+        free537(ptr);
+	freeSignal = 1;
+  	void *a = realloc(ptr, size);
+	//the new block takes the place of the old one in its scope, or stays out of scopes like it
+	Node *node = track(a, size, freedLink);
+	TRACE(REALLOC, old, node->start, size);
+	return node->start;
+    }
+}
+
+
+/*
+Like malloc537(), for nmemb elements of size bytes each, zeroed by calloc(). Exits if nmemb * size does not fit in a size_t.
+*/
+void *calloc537(size_t nmemb, size_t size){
+    size_t total;
+
+    if (__builtin_mul_overflow(nmemb, size, &total)) {
+        fprintf(stderr, "Error: calloc537 of %zu elements of size %zu overflows\n", nmemb, size);
+        exit(-1);
+    }
+    check_size(total, "calloc");
+    init537();
+    void *a;
+#ifdef SLAB537
+    if (total <= SLAB_MAX && scopes == NULL) {
+        a = memset(alloc537(total, NULL), 0, total);
+        TRACE(CALLOC, NULL, a, total);
+        return a;
+    }
+#endif
+    a = track(calloc(nmemb, size), total, scope_head())->start;
+    TRACE(CALLOC, NULL, a, total);
+    return a;
+}
+
+/*
+Like malloc537(), for a block whose address is a multiple of alignment. Returns the error number of posix_memalign() instead of exiting, and leaves *memptr alone on error.
+*/
+int posix_memalign537(void **memptr, size_t alignment, size_t size){
+    void *a;
+    int err;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment % sizeof(void *) != 0)
+        return EINVAL;
+    if (size > PTRDIFF_MAX)
+        return ENOMEM;
+    if (size == 0) {
+	printf("Warning! Trying to posix_memalign 0 size!\n");
+    }
+    init537();
+    if ((err = posix_memalign(&a, alignment, size)) != 0)
+        return err;
+    *memptr = track(a, size, scope_head())->start;
+    TRACE(ALIGNED, alignment, *memptr, size);
+    return 0;
+}
+
+/*
+Like malloc537(), for a block whose address is a multiple of alignment. Exits if alignment is not a power of two multiple of sizeof(void *).
+*/
+void *aligned_alloc537(size_t alignment, size_t size){
+    void *a;
+
+    switch (posix_memalign537(&a, alignment, size)) {
+    case 0:
+        return a;
+    case EINVAL:
+        fprintf(stderr, "Error: alignment %zu is not a power of two multiple of %zu\n", alignment, sizeof(void *));
+        exit(-1);
+    default:
+        check_size(size, "aligned_alloc");
+        fprintf(stderr, "Error: No space for malloc\n");
+        exit(-1);
+    }
+}
+
+
+/*
+Return the start of the allocated block that holds the whole range [ptr, ptr+size), with one tree search at most. On error print the memcheck537 error message, prefixed with who, and exit.
+*/
+static void* check_range(void *ptr, size_t size, const char *who){
+    Node *node;
+    int i;
+
+    //exit if NULL pointer passed in
+    if (ptr == NULL){
+        fprintf(stderr, "Error: %scannot check memory space for NULL pointer\n", who);
+        exit(-1);
+    }
+#ifdef SLAB537
+    SlabBlock blk;
+    int found = slab_lookup(ptr, &blk);
+
+    //a 0 byte block covers no byte, as in the tree; slab_lookup only matches its start so free537 finds it
+    if ((found == SLAB_LIVE || found == SLAB_FREED) && blk.size == 0)
+        found = SLAB_NONE;
+    switch (found) {
+    case SLAB_LIVE:
+        if (size > blk.size - (size_t)(ptr - blk.start)){
+            fprintf(stderr,"Error: %sThe checking memory space beyond the boundry\n", who);
+            exit(-1);
+        }
+        return blk.start;
+    case SLAB_FREED:
+        fprintf(stderr, "Error: %sThe checking memory space has been freed\n", who);
+        exit(-1);
+    case SLAB_CORRUPT:
+        fprintf(stderr, "Error: %sThe header of the block at %p has been overwritten\n", who, blk.start);
+        exit(-1);
+    }
+#endif
+    for (i = 0; i < 2; i++){
+        node = hits[i];
+        if (node != NULL && node->freeFlag == 1 && ptr >= node->start
+            && (size_t)(ptr - node->start) < node->size && size <= node->size - (size_t)(ptr - node->start))
+            return node->start;
+    }
+
+    node = counter ? root->node : NULL;
+    //search the whole tree
+    while(node!=NULL){
+        //target addr is smaller than current block's starting addr
+        if (ptr < node->start){
+            node = node->left;
+        }
+        //target addr is bigger than current block's ending addr
+        else if (ptr > (node->start + node->size -1)){
+            node = node->right;
+        }
+        //target addr is within the current block's addr 
+        else{
+            //error if the current block has been freed
+            if (node->freeFlag == 0){
+                fprintf(stderr, "Error: %sThe checking memory space has been freed\n", who);
+                exit(-1);
+            }
+            //determine if the size of searching mem is larger than current block's ending addr
+            if (size > node->size - (size_t)(ptr - node->start)){
+                fprintf(stderr,"Error: %sThe checking memory space beyond the boundry\n", who);
+                exit(-1);
+            }
+            hits[nextHit] = node;
+            nextHit ^= 1;
+            return node->start;
+        }
+    }
+
+    //serach the whole tree but cannot find checking memory space
+    fprintf(stderr, "Error: %sThe checking memory space has not been allocated\n", who);
+    exit(-1);
+}
+
+/*
+This function checks to see the address range specified by address ptr and length size are fully within a range allocated by malloc537() and memory not yet freed by free537(). When an error is detected, then print out a detailed and informative error message and exit the program (with a -1 status). 
+*/
+void memcheck537(void *ptr, size_t size){
+    void *start = check_range(ptr, size, "");
+
+    TRACE(MEMCHECK, ptr, start, size);
+    printf("The checking memory space has been allocated\n");
+}
+
+/*
+memcpy() with both ranges checked like memcheck537 before any byte is copied, with one tree search per operand at most and nothing printed on success. Overlapping ranges are an error, as they are for memcpy(); use memmove537 for those.
+*/
+void *memcpy537(void *dst, const void *src, size_t n){
+    if (n == 0)
+        return dst;
+    check_range(dst, n, "memcpy537 destination: ");
+    check_range((void *)src, n, "memcpy537 source: ");
+    if ((char *)dst < (char *)src + n && (char *)src < (char *)dst + n){
+        fprintf(stderr, "Error: memcpy537 source %p and destination %p overlap for %zu bytes, use memmove537\n", src, dst, n);
+        exit(-1);
+    }
+    return memcpy(dst, src, n);
+}
+
+/*
+memmove() with both ranges checked like memcheck537 before any byte is moved.
+*/
+void *memmove537(void *dst, const void *src, size_t n){
+    if (n == 0)
+        return dst;
+    check_range(dst, n, "memmove537 destination: ");
+    check_range((void *)src, n, "memmove537 source: ");
+    return memmove(dst, src, n);
+}
+
+/*
+memset() with the range checked like memcheck537 before any byte is written.
+*/
+void *memset537(void *ptr, int c, size_t n){
+    if (n == 0)
+        return ptr;
+    check_range(ptr, n, "memset537: ");
+    return memset(ptr, c, n);
+}
+
+
+/*
+Open a new innermost scope.
+*/
+void malloc537_scope_begin(void){
+    scope *s;
+
+    if ((s = malloc(sizeof(scope))) == NULL){
+        fprintf(stderr, "Error: No space for a new scope\n");
+        exit(-1);
+    }
+    s->head = NULL;
+    s->outer = scopes;
+    scopes = s;
+}
+
+/*
+Close the innermost scope and free every block allocated in it that is still allocated. The nodes stay in the tree as freed blocks, exactly as free537 leaves them, so a later free537 of one of these blocks is still reported as a double free; only the tree search of free537 is saved.
+*/
+void malloc537_scope_end(void){
+    scope *s = scopes;
+    Node *node, *next;
+
+    if (s == NULL){
+        fprintf(stderr, "Error: malloc537_scope_end() called without an open scope\n");
+        exit(-1);
+    }
+    for (node = s->head; node != NULL; node = next){
+        next = node->scope_next;
+        node->freeFlag = 0;
+        node->scope_next = NULL;
+        node->scope_pprev = NULL;
+        node->free_epoch = ++root->epoch;
+        TRACE(FREE, node->start, NULL, 0);
+        free(node->start);
+    }
+    scopes = s->outer;
+    free(s);
+}
+
+
+/*
+Remove all freed nodes from the tree in one O(n) rebuild.
+*/
+void compact537(void){
+    if (counter)
+        rbtree_compact(root);
+    hits[0] = hits[1] = NULL;
+}
+
+
+/*
+Start a walk over the tracked blocks, see rbcursor_seek.
+*/
+Node* seek537(RBCursor *cur, void *addr, int filter){
+    return rbcursor_seek(cur, counter ? root : NULL, addr, filter);
+}
+
+
+/*
+Take a snapshot of the tracked heap. A snapshot is only the current epoch of the tree, so this is O(1).
+*/
+snapshot537 snapshot537_take(void){
+    return counter ? root->epoch : 0;
+}
+
+/*
+Write to fd every block allocated after snapshot a that was still allocated at snapshot b, one "address size" line per block in address order, followed by a total. Subtrees with no block newer than a are skipped through max_epoch, so the cost follows the number of new blocks and not the size of the heap. The result is exact when b is taken right before the call; with an older b, blocks freed after b whose nodes were since removed by address reuse or compact537 are missed.
+*/
+void snapshot537_diff(snapshot537 a, snapshot537 b, int fd){
+    unsigned long count = 0;
+    unsigned long long bytes = 0;
+    writer w;
+    Node *node;
+
+    w.fd = fd;
+    w.len = 0;
+    for (node = rbtree_first_since(counter ? root : NULL, a); node != NULL; node = rbtree_next_since(node, a)) {
+        if (node->epoch > b || (node->freeFlag == 0 && node->free_epoch <= b))
+            continue;
+        writer_printf(&w, "%p %zu\n", node->start, node->size);
+        count++;
+        bytes += node->size;
+    }
+    writer_printf(&w, "%lu blocks (%llu bytes) allocated after snapshot %lu and not freed at snapshot %lu\n",
+        count, bytes, a, b);
+    writer_flush(&w);
+}
+
+/*
+Write the tree to fd in the binary format of dump537.h, for offline analysis of fragmentation and freed blocks with inspect537. Returns 0 on success and -1 if a write failed.
+*/
+int dump537(int fd){
+    return rbtree_dump(counter ? root : NULL, fd);
+}
+
+
+void printEverything(){
+    print_rbtree(root);
+}   
@@ -1,13 +1,113 @@
-#ifndef _537malloc_H_
-#define _537malloc_H_
-#include "range_tree.h"
-
-void printEverything();
-
-
-void *malloc537(int size);
-void free537(void *ptr);
-void *realloc537(void *ptr, int size);
-void memcheck537(void *ptr, int size);
-
-#endif
+#ifndef _537malloc_H_
+#define _537malloc_H_
+#include "range_tree.h"
+
+void printEverything();
+
+
+void *malloc537(size_t size);
+void free537(void *ptr);
+void *realloc537(void *ptr, size_t size);
+void memcheck537(void *ptr, size_t size);
+
+/*calloc537 zeroes the block like calloc(). aligned_alloc537 and
+ posix_memalign537 return a block aligned to alignment, which must be a power
+ of two and a multiple of sizeof(void *); the tracked range is exactly the
+ size bytes at the returned address. posix_memalign537 returns EINVAL or
+ ENOMEM instead of exiting, like posix_memalign(). realloc537 does not keep
+ the alignment of a block.*/
+void *calloc537(size_t nmemb, size_t size);
+void *aligned_alloc537(size_t alignment, size_t size);
+int posix_memalign537(void **memptr, size_t alignment, size_t size);
+
+/*memcpy, memmove and memset with every range checked like memcheck537
+ before memory is touched, at most one tree search per operand and nothing
+ printed on success. memcpy537 also rejects overlapping ranges.*/
+void *memcpy537(void *dst, const void *src, size_t n);
+void *memmove537(void *dst, const void *src, size_t n);
+void *memset537(void *ptr, int c, size_t n);
+
+/*Scopes: every block allocated between malloc537_scope_begin() and the
+ matching malloc537_scope_end() and still allocated then is freed by
+ malloc537_scope_end(), in time linear in the number of blocks. Scopes nest,
+ a block belongs to the innermost open scope. Freeing such a block again
+ afterwards is reported as a double free.*/
+void malloc537_scope_begin(void);
+void malloc537_scope_end(void);
+
+/*Drop every freed block from the tree and rebalance it. Afterwards a free537
+ of one of the dropped blocks is reported as never allocated instead of as a
+ double free.*/
+void compact537(void);
+
+/*Put cur on the first tracked block matching filter (RB_LIVE, RB_FREED or
+ RB_ALL) that ends at or after addr; walk on with rbcursor_next and
+ rbcursor_prev from range_tree.h. The cursor is invalid once a block is
+ allocated, realloc'ed or compacted away.*/
+Node* seek537(RBCursor *cur, void *addr, int filter);
+
+/*Heap snapshots for finding slow leaks: take one at time A and one at time
+ B, then snapshot537_diff(a, b, fd) writes the blocks allocated between them
+ and not freed by B. Taking a snapshot is O(1).*/
+typedef unsigned long snapshot537;
+snapshot537 snapshot537_take(void);
+void snapshot537_diff(snapshot537 a, snapshot537 b, int fd);
+
+/*Write every block of the tree, allocated or freed, to fd in the binary
+ format of dump537.h; inspect537 summarizes a dump. 0 on success, -1 if a
+ write failed. Blocks in the slabs of a SLAB537 build are not in the tree.*/
+int dump537(int fd);
+
+/*Check level, chosen per translation unit with -DMALLOC537_CHECK_LEVEL=n
+ (make CHECK_LEVEL=n for main.c):
+   2  full, the default: every call goes to the library.
+   1  sampled: memcheck537 and the range checks of memcpy537, memmove537 and
+      memset537 run on the first call of every call site and then on one
+      call in MALLOC537_SAMPLE_RATE (default 64) of it; the other calls
+      cost an inline counter. Allocation and free537 are still tracked on
+      every call.
+   0  off: the allocation calls are the libc ones, free537 is free() and
+      memcheck537 compiles to nothing. Nothing is tracked, so a block must
+      not be allocated at level 0 and freed at a higher level or the other
+      way around. The scope, compact537, seek537, snapshot and dump537
+      functions are not mapped: a file using them still links the library,
+      and they only see the blocks of files built at level 1 or 2.*/
+#ifndef MALLOC537_CHECK_LEVEL
+#define MALLOC537_CHECK_LEVEL 2
+#endif
+
+#if MALLOC537_CHECK_LEVEL == 1
+#ifndef MALLOC537_SAMPLE_RATE
+#define MALLOC537_SAMPLE_RATE 64
+#endif
+#include <string.h>
+
+/*1 on the first call and then every MALLOC537_SAMPLE_RATE-th call of one
+ call site: every expansion has its own counter, so call sites that run in
+ step cannot take each other's samples. Needs GNU statement expressions.*/
+#define MALLOC537_SAMPLE() __extension__ ({ \
+    static unsigned int malloc537_calls; \
+    malloc537_calls++ % MALLOC537_SAMPLE_RATE == 0; })
+
+#define memcheck537(ptr, size) (MALLOC537_SAMPLE() ? memcheck537(ptr, size) : (void)0)
+#define memcpy537(dst, src, n) (MALLOC537_SAMPLE() ? memcpy537(dst, src, n) : memcpy(dst, src, n))
+#define memmove537(dst, src, n) (MALLOC537_SAMPLE() ? memmove537(dst, src, n) : memmove(dst, src, n))
+#define memset537(ptr, c, n) (MALLOC537_SAMPLE() ? memset537(ptr, c, n) : memset(ptr, c, n))
+
+#elif MALLOC537_CHECK_LEVEL == 0
+#include <stdlib.h>
+#include <string.h>
+
+#define malloc537(size) malloc(size)
+#define free537(ptr) free(ptr)
+#define realloc537(ptr, size) realloc(ptr, size)
+#define calloc537(nmemb, size) calloc(nmemb, size)
+#define aligned_alloc537(alignment, size) aligned_alloc(alignment, size)
+#define posix_memalign537(memptr, alignment, size) posix_memalign(memptr, alignment, size)
+#define memcheck537(ptr, size) ((void)(ptr), (void)(size))
+#define memcpy537(dst, src, n) memcpy(dst, src, n)
+#define memmove537(dst, src, n) memmove(dst, src, n)
+#define memset537(ptr, c, n) memset(ptr, c, n)
+#endif
+
+#endif
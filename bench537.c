@@ -0,0 +1,347 @@
+/*
+ * bench537: microbenchmarks for the 537 API
+ *
+ * Every benchmark runs against a heap of N live blocks for each N in
+ * 1K, 10K, ..., 10M (capped with -m). Each heap size runs in its own forked
+ * child, because the range tree only ever grows in a process. Every operation
+ * is timed on its own and the ns/op percentiles are reported, together with
+ * the memory the library needs per tracked block on top of plain malloc().
+ *
+ * Usage: bench537 [-m maxblocks] [-n ops] [-b baselinefile]
+ *     -m    largest heap size to run (default 10000000)
+ *     -n    timed operations per benchmark (default 100000)
+ *     -b    print the p50 of every line relative to a saved run
+ *
+ * "make bench" runs it against bench_baseline.txt, "make bench-baseline"
+ * rewrites that file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "537malloc.h"
+
+// size of the blocks in the heap
+#define MINSIZE 16
+#define MAXSIZE 256
+// blocks that get merged by free in the reuse-merge benchmark, bigger than the glibc tcache limit
+#define MERGESIZE 1100
+#define MERGEGROUPS 1000
+
+static FILE *out;
+static unsigned long ops = 100000;
+
+// per benchmark samples in ns
+static uint64_t *samples;
+static unsigned long nsamples;
+
+// the heap
+static char **live;
+static size_t *sizes;
+static unsigned long nlive;
+
+static uint64_t rng = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t xorshift(void){
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static unsigned long pick(unsigned long n){
+    return xorshift() % n;
+}
+
+static size_t blocksize(void){
+    return MINSIZE + pick(MAXSIZE - MINSIZE + 1);
+}
+
+static inline uint64_t now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#define TIMED(stmt) do { uint64_t t_ = now(); stmt; samples[nsamples++] = now() - t_; } while (0)
+
+static int cmp_u64(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *name){
+    if (nsamples == 0)
+        return;
+    qsort(samples, nsamples, sizeof(uint64_t), cmp_u64);
+    fprintf(out, "%-14s %9lu %7llu %7llu %7llu %9llu\n", name, nlive,
+        (unsigned long long)samples[nsamples * 50 / 100],
+        (unsigned long long)samples[nsamples * 90 / 100],
+        (unsigned long long)samples[nsamples * 99 / 100],
+        (unsigned long long)samples[nsamples - 1]);
+    fflush(out);
+    nsamples = 0;
+}
+
+// bytes in use on the heap plus bytes in mmapped chunks, where the slabs of a SLAB537 build live
+static size_t heap_in_use(void){
+    struct mallinfo2 mi = mallinfo2();
+
+    return mi.uordblks + mi.hblkhd;
+}
+
+/*Bytes per block the library needs on top of malloc() for the same sizes.
+ Allocates the heap with plain malloc first, then with malloc537.*/
+static void build_heap(void){
+    size_t before, plain, tracked;
+    unsigned long i;
+
+    for (i = 0; i < nlive; i++)
+        sizes[i] = blocksize();
+
+    before = heap_in_use();
+    for (i = 0; i < nlive; i++)
+        live[i] = malloc(sizes[i]);
+    plain = heap_in_use() - before;
+    for (i = 0; i < nlive; i++)
+        free(live[i]);
+    malloc_trim(0);
+
+    before = heap_in_use();
+    for (i = 0; i < nlive; i++)
+        live[i] = malloc537(sizes[i]);
+    tracked = heap_in_use() - before;
+
+    fprintf(out, "%-14s %9lu %7.1f\n", "overhead", nlive,
+        ((double)tracked - (double)plain) / nlive);
+}
+
+// free 4 neighbouring blocks and allocate their merged size, the new node covers 4 tombstones
+static void bench_reuse_merge(void){
+    char *group[4];
+    int i, j;
+
+    for (i = 0; i < MERGEGROUPS; i++) {
+        for (j = 0; j < 4; j++)
+            group[j] = malloc537(MERGESIZE);
+        for (j = 0; j < 4; j++)
+            free537(group[j]);
+        TIMED(group[0] = malloc537(4 * MERGESIZE));
+        free537(group[0]);
+    }
+    report("reuse-merge");
+}
+
+// free a block and allocate the same size again, usually at the same address
+static void bench_reuse(void){
+    unsigned long i, r;
+
+    for (i = 0; i < ops; i++) {
+        r = pick(nlive);
+        free537(live[r]);
+        TIMED(live[r] = malloc537(sizes[r]));
+    }
+    report("reuse");
+}
+
+// free a random block and allocate one of a new size
+static void bench_churn(void){
+    uint64_t *freed = malloc(ops * sizeof(uint64_t));
+    unsigned long i, r;
+    uint64_t t;
+
+    for (i = 0; i < ops; i++) {
+        r = pick(nlive);
+        t = now();
+        free537(live[r]);
+        freed[i] = now() - t;
+        sizes[r] = blocksize();
+        TIMED(live[r] = malloc537(sizes[r]));
+    }
+    report("malloc");
+    memcpy(samples, freed, ops * sizeof(uint64_t));
+    nsamples = ops;
+    report("free");
+    free(freed);
+}
+
+// grow random blocks by half, start over at MINSIZE once they pass 4K
+static void bench_realloc(void){
+    unsigned long i, r;
+
+    for (i = 0; i < ops; i++) {
+        r = pick(nlive);
+        sizes[r] = sizes[r] > 4096 ? MINSIZE : sizes[r] + sizes[r] / 2;
+        TIMED(live[r] = realloc537(live[r], sizes[r]));
+    }
+    report("realloc");
+}
+
+static void bench_memcheck(void){
+    unsigned long i, r;
+    size_t off;
+
+    for (i = 0; i < ops; i++) {
+        r = i % nlive;
+        TIMED(memcheck537(live[r], sizes[r]));
+    }
+    report("memcheck-seq");
+
+    for (i = 0; i < ops; i++) {
+        r = pick(nlive);
+        off = pick(sizes[r]);
+        TIMED(memcheck537(live[r] + off, 1 + pick(sizes[r] - off)));
+    }
+    report("memcheck-rand");
+}
+
+// copy between two random blocks, both operands checked
+static void bench_memcpy(void){
+    unsigned long i, r, w;
+
+    for (i = 0; i < ops; i++) {
+        r = pick(nlive);
+        w = pick(nlive);
+        if (r == w)
+            continue;
+        TIMED(memcpy537(live[w], live[r], sizes[r] < sizes[w] ? sizes[r] : sizes[w]));
+    }
+    report("memcpy537");
+}
+
+static void run(unsigned long n){
+    nlive = n;
+    live = malloc(n * sizeof(char *));
+    sizes = malloc(n * sizeof(size_t));
+    samples = malloc((ops > MERGEGROUPS ? ops : MERGEGROUPS) * sizeof(uint64_t));
+    if (live == NULL || sizes == NULL || samples == NULL) {
+        fprintf(stderr, "Error: no space for a heap of %lu blocks\n", n);
+        exit(1);
+    }
+    rng ^= n;
+
+    build_heap();
+    bench_memcheck();
+    bench_memcpy();
+    bench_churn();
+    bench_realloc();
+    bench_reuse();
+    bench_reuse_merge();
+}
+
+/*Baseline: the output of an earlier run. Only the p50 column is compared.*/
+typedef struct baseline{
+    char name[16];
+    unsigned long blocks;
+    double p50;
+}baseline;
+
+static baseline *base;
+static int nbase;
+
+static void load_baseline(const char *path){
+    char line[256];
+    baseline b;
+    FILE *f = fopen(path, "r");
+    int cap = 0;
+
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%15s %lu %lf", b.name, &b.blocks, &b.p50) != 3)
+            continue;
+        if (nbase == cap) {
+            cap = cap ? 2 * cap : 64;
+            base = realloc(base, cap * sizeof(baseline));
+        }
+        base[nbase++] = b;
+    }
+    fclose(f);
+}
+
+// echo the results of a child and append the change against the baseline
+static void compare(FILE *in){
+    char line[256];
+    baseline b;
+    int i;
+
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\n")] = '\0';
+        fputs(line, stdout);
+        if (sscanf(line, "%15s %lu %lf", b.name, &b.blocks, &b.p50) == 3) {
+            for (i = 0; i < nbase; i++) {
+                if (strcmp(base[i].name, b.name) == 0 && base[i].blocks == b.blocks) {
+                    if (base[i].p50 > 0)
+                        printf("  %+6.1f%%", 100.0 * (b.p50 - base[i].p50) / base[i].p50);
+                    break;
+                }
+            }
+        }
+        putchar('\n');
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv){
+    unsigned long maxblocks = 10000000, n;
+    int opt, fds[2];
+    pid_t pid;
+
+    while ((opt = getopt(argc, argv, "m:n:b:")) != -1) {
+        switch (opt) {
+        case 'm':
+            maxblocks = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            ops = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            load_baseline(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: bench537 [-m maxblocks] [-n ops] [-b baselinefile]\n");
+            return 2;
+        }
+    }
+    if (ops == 0)
+        ops = 1;
+
+    printf("# bench537: ns/op percentiles, overhead is bytes per tracked block over plain malloc\n");
+    printf("%-14s %9s %7s %7s %7s %9s\n", "benchmark", "blocks", "p50", "p90", "p99", "max");
+    fflush(stdout);
+
+    for (n = 1000; n <= maxblocks; n *= 10) {
+        if (pipe(fds) < 0 || (pid = fork()) < 0) {
+            perror("bench537");
+            return 1;
+        }
+        if (pid == 0) {
+            // memcheck537 reports every successful check on stdout, keep that out of the results
+            close(fds[0]);
+            out = fdopen(fds[1], "w");
+            if (freopen("/dev/null", "w", stdout) == NULL)
+                perror("/dev/null");
+            run(n);
+            fclose(out);
+            _exit(0);
+        }
+        close(fds[1]);
+        FILE *in = fdopen(fds[0], "r");
+        compare(in);
+        fclose(in);
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "bench537: run with %lu blocks failed\n", n);
+            return 1;
+        }
+    }
+    return 0;
+}
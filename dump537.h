@@ -0,0 +1,30 @@
+#ifndef dump537_h
+#define dump537_h
+#include <stdint.h>
+
+/*Binary dump of a range tree written by rbtree_dump (dump537() for the
+ tree of the library). The file is a dump537_header followed by one
+ fixed-width dump537_record per node, in address order. load_rbtree maps a
+ dump and builds a new tree from it; inspect537 reads this format.*/
+
+#define DUMP537_MAGIC   "537DUMP"
+#define DUMP537_VERSION 1
+
+// bits of dump537_record.flags
+#define DUMP537_LIVE    1    // allocated block, freeFlag 1; freed blocks still in the tree have it clear
+#define DUMP537_RED     2    // red node
+
+typedef struct dump537_header{
+    char     magic[8];        // DUMP537_MAGIC, NUL terminated
+    uint32_t version;         // DUMP537_VERSION
+    uint32_t record_size;     // sizeof(dump537_record)
+}dump537_header;
+
+typedef struct dump537_record{
+    uint64_t start;           // first byte of the block
+    uint64_t size;            // size of the block
+    uint32_t flags;           // DUMP537_ bits
+    uint32_t depth;           // edges from the root of the tree, the root has depth 0
+}dump537_record;
+
+#endif
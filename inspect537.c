@@ -0,0 +1,123 @@
+/*
+ * inspect537: summarize a range tree dump written by dump537() or
+ * rbtree_dump() (see dump537.h).
+ *
+ * The dump is mapped with mmap and read once in address order. It reports
+ * the allocated and freed blocks still in the tree, the gaps between
+ * neighbouring blocks, and the depth of the dumped tree. Then it rebuilds an
+ * index from the dump with load_rbtree and checks it with rbtree_verify.
+ *
+ * Usage: inspect537 dumpfile
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "range_tree.h"
+#include "dump537.h"
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv){
+    const dump537_header *hdr;
+    const dump537_record *rec;
+    struct stat st;
+    size_t n, i;
+    unsigned long live = 0, freed = 0, gaps = 0, deepest = 0;
+    unsigned long long liveBytes = 0, freedBytes = 0, gapBytes = 0, maxGap = 0, maxFreed = 0, depthSum = 0;
+    RBRoot *root;
+    void *base;
+    double t0, t1;
+    int fd;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: inspect537 dumpfile\n");
+        return 2;
+    }
+    if ((fd = open(argv[1], O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    if ((size_t)st.st_size < sizeof(dump537_header)) {
+        fprintf(stderr, "Error: %s is not a range tree dump\n", argv[1]);
+        return 1;
+    }
+    if ((base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    hdr = base;
+    if (memcmp(hdr->magic, DUMP537_MAGIC, sizeof(hdr->magic)) != 0
+        || hdr->version != DUMP537_VERSION || hdr->record_size != sizeof(dump537_record)) {
+        fprintf(stderr, "Error: %s is not a version %d range tree dump\n", argv[1], DUMP537_VERSION);
+        return 1;
+    }
+    rec = (const dump537_record *)(hdr + 1);
+    n = (st.st_size - sizeof(*hdr)) / sizeof(dump537_record);
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    for (i = 0; i < n; i++) {
+        if (rec[i].flags & DUMP537_LIVE) {
+            live++;
+            liveBytes += rec[i].size;
+        } else {
+            freed++;
+            freedBytes += rec[i].size;
+            if (rec[i].size > maxFreed)
+                maxFreed = rec[i].size;
+        }
+        depthSum += rec[i].depth;
+        if (rec[i].depth > deepest)
+            deepest = rec[i].depth;
+        if (i == 0)
+            continue;
+        if (rec[i].start < rec[i - 1].start + rec[i - 1].size) {
+            fprintf(stderr, "Error: record %zu at %#llx is not after the record before it\n", i,
+                (unsigned long long)rec[i].start);
+            return 1;
+        }
+        if (rec[i].start > rec[i - 1].start + rec[i - 1].size) {
+            unsigned long long gap = rec[i].start - (rec[i - 1].start + rec[i - 1].size);
+            gaps++;
+            gapBytes += gap;
+            if (gap > maxGap)
+                maxGap = gap;
+        }
+    }
+
+    printf("%s: %zu nodes", argv[1], n);
+    if (n)
+        printf(" covering %#llx-%#llx", (unsigned long long)rec[0].start,
+            (unsigned long long)(rec[n - 1].start + rec[n - 1].size));
+    printf("\n");
+    printf("    allocated %10lu blocks %14llu bytes\n", live, liveBytes);
+    printf("    freed     %10lu blocks %14llu bytes, largest %llu, %.1f%% of the nodes\n", freed, freedBytes,
+        maxFreed, n ? 100.0 * freed / n : 0.0);
+    printf("    gaps      %10lu        %14llu bytes, largest %llu\n", gaps, gapBytes, maxGap);
+    printf("    depth     max %lu, mean %.1f\n", deepest, n ? (double)depthSum / n : 0.0);
+
+    t0 = now();
+    root = load_rbtree(fd);
+    t1 = now();
+    if (root == NULL) {
+        fprintf(stderr, "Error: cannot rebuild an index from %s\n", argv[1]);
+        return 1;
+    }
+    if (rbtree_verify(root) < 0)
+        return 1;
+    printf("    rebuilt the index in %.3f s\n", t1 - t0);
+    destroy_rbtree(root);
+    munmap(base, st.st_size);
+    close(fd);
+    return 0;
+}
@@ -1,708 +1,1464 @@
-/**
- * Implementing Red-Black Tree by C
- * The basic building steps of Red-BLack Tree is borrow from skywang 
- * who generated the RedBlackTree library at https://www.cnblogs.com/skywang12345/p/3624177.html on 2013/11/18
- * Yifan and Siyuan adds some codes to make sure the basic red black tree library works 
- * for current oproject 4 
- */
-
-#include <stdio.h>
-#include <stdlib.h>
-#include "range_tree.h"
-
-/*define some RB Tree basic contents at the top*/
-#define rb_parent(r)   ((r)->parent)
-#define rb_color(r) ((r)->color)
-#define rb_is_red(r)   ((r)->color==RED)
-#define rb_is_black(r)  ((r)->color==BLACK)
-#define rb_set_black(r)  do {if (r) (r)->color = BLACK; } while (0)
-#define rb_set_red(r)  do {if (r) (r)->color = RED; } while (0)
-#define rb_set_parent(r,p)  do { if (r) (r)->parent = (p); } while (0)
-#define rb_set_color(r,c)  do { if (r) (r)->color = (c); } while (0)
-//define a buffer size that we will use as the initialized capacity of delete list where we store the nodes needed to be deleted
-#define buffersize 32
-
-/*Function: 
- * create a Red Black Tree and Return the root of a Red Black Tree
- */
-RBRoot* create_rbtree()
-{
-    RBRoot *root = (RBRoot *)malloc(sizeof(RBRoot));
-    root->node = NULL;
-    return root;
-}
-
-
-/* Function:
- * Use recursion to search the RB Tree and find the node with start address, ptr
- * 
- * Parameters:
- * x		the RB Tree
- * ptr		the pointer of the node getting search
- */
-static Node* search(RBTree x, void *ptr)
-{
-    if (x==NULL || x->start==ptr)
-        return x;
-
-    if (ptr < x->start)
-        return search(x->left, ptr);
-    else
-        return search(x->right, ptr);
-}
-
-int rbtree_search(RBRoot *root, void *ptr)
-{
-    if (root)
-        return search(root->node, ptr)? 0 : -1;
-    return -1;
-}
-
-
-
-/* Function: 
- * Do left rotation to RB Tree
- *
- * Here is how left rotation works for node x：
- *      px                              px
- *     /                               /
- *    x                               y                
- *   /  \     -(left rotation)->     / \               
- *  lx   y                          x  ry     
- *     /   \                       /  \
- *    ly   ry                     lx  ly  
- *
- * Parameters:
- * root:   RB tree
- * x:	   node getting to be left rotate
- */
-static void rbtree_left_rotate(RBRoot *root, Node *x)
-{
-    // let x's right to be y
-    Node *y = x->right;
-
-    // set y's left to be x's right
-    // if y's left exists, x to be y's left's new parent
-    x->right = y->left;
-    if (y->left != NULL)
-        y->left->parent = x;
-
-    // let x's parent to be y's parent
-    y->parent = x->parent;
-
-    if (x->parent == NULL)
-    {
-        root->node = y;            // if x does not have a patent, then y would be the root node
-    }
-    else
-    {
-        if (x->parent->left == x)
-            x->parent->left = y;    // if x is the left child of its parent, let y be x's parent's left child
-        else
-            x->parent->right = y;    // if x is the right child of its parent, let y be x's parent's right child
-    }
-    
-    // let y's left to be x
-    y->left = x;
-    // let x's parent to be y
-    x->parent = y;
-}
-
-/* Function:
- * Do right rotation to RB Tree
- *
- * Here is how right rotation works for node x：
- *            py                               py
- *           /                                /
- *          y                                x                  
- *         /  \    -(right rotation)->      /  \                    
- *        x   ry                           lx   y  
- *       / \                                   / \                  
- *      lx  rx                                rx  ry
- * Parameters:
- * root:   RB tree
- * x:	   node getting to be left rotate
- */
-static void rbtree_right_rotate(RBRoot *root, Node *y)
-{
-    // set x to be y's left
-    Node *x = y->left;
-
-    // set x's right to be y's left
-    //if x's right exists, set x's right's parent to be y
-    y->left = x->right;
-    if (x->right != NULL)
-        x->right->parent = y;
-
-    // set y's parent to be x's parent
-    x->parent = y->parent;
-
-    if (y->parent == NULL) 
-    {
-        root->node = x;            // if y's parent does not exist, set x to be the root node
-    }
-    else
-    {
-        if (y == y->parent->right)
-            y->parent->right = x;    // if y is its parent's right, set y's parent's right to be x
-        else
-            y->parent->left = x;    // set y's parent's left to be x
-    }
-
-    // set x's right to be y
-    x->right = y;
-
-    // set y's parent to be x
-    y->parent = x;
-}
-
-/* Function:
- * Fixup function for the deletion of RB Tree
- *
- * After RB tree finish its deletion, and its balance cannot keep, 
- * call this function to fix the balance so that we reget a RB Tree
- *
- * Parameters：
- *     root   RB Tree's root
- *     node   node waiting to be fixed
- */
-static void rbtree_delete_fixup(RBRoot *root, Node *node, Node *parent)
-{
-    Node *other;
-
-    while ((!node || rb_is_black(node)) && node != root->node)
-    {
-        if (parent->left == node)
-        {
-            other = parent->right;
-            if (rb_is_red(other))
-            {
-                // Case 1: x's sibling is red  
-                rb_set_black(other);
-                rb_set_red(parent);
-                rbtree_left_rotate(root, parent);
-                other = parent->right;
-            }
-            if ((!other->left || rb_is_black(other->left)) &&
-                (!other->right || rb_is_black(other->right)))
-            {
-                // Case 2: x's sibling + x's newphews are black 
-                rb_set_red(other);
-                node = parent;
-                parent = rb_parent(node);
-            }
-            else
-            {
-                if (!other->right || rb_is_black(other->right))
-                {
-                    // Case 3: x's sibling is black, x's left newphew is red, x's right newphew is black  
-                    rb_set_black(other->left);
-                    rb_set_red(other);
-                    rbtree_right_rotate(root, other);
-                    other = parent->right;
-                }
-                // Case 4: x's sibling is black, x's right newphew is red
-                rb_set_color(other, rb_color(parent));
-                rb_set_black(parent);
-                rb_set_black(other->right);
-                rbtree_left_rotate(root, parent);
-                node = root->node;
-                break;
-            }
-        }
-        else
-        {
-            other = parent->left;
-            if (rb_is_red(other))
-            {
-                // Case 1: x's sibling is red 
-                rb_set_black(other);
-                rb_set_red(parent);
-                rbtree_right_rotate(root, parent);
-                other = parent->left;
-            }
-            if ((!other->left || rb_is_black(other->left)) &&
-                (!other->right || rb_is_black(other->right)))
-            {
-                // Case 2: Case 2: x's sibling + x's newphews are black 
-                rb_set_red(other);
-                node = parent;
-                parent = rb_parent(node);
-            }
-            else
-            {
-                if (!other->left || rb_is_black(other->left))
-                {
-                    // Case 3:x's sibling is black, x's left newphew is red, x's right newphew is black   
-                    rb_set_black(other->right);
-                    rb_set_red(other);
-                    rbtree_left_rotate(root, other);
-                    other = parent->left;
-                }
-                // Case 4:x's sibling is black, x's right newphew is red
-                rb_set_color(other, rb_color(parent));
-                rb_set_black(parent);
-                rb_set_black(other->left);
-                rbtree_right_rotate(root, parent);
-                node = root->node;
-                break;
-            }
-        }
-    }
-    if (node)
-        rb_set_black(node);
-}
-
-/* Function:
- * Deleting a node from RB Tree
- *
- * Parameters：
- *     tree 	RB Tree
- *     node 	node waiting to be deleted
- */
-void rbtree_delete(RBRoot *root, Node *node)
-{
-    Node *child, *parent;
-    int color;
-
-    // if node has 2 children
-    if ( (node->left!=NULL) && (node->right!=NULL) ) 
-    {
-        Node *replace = node;
-
-        // get subcessor(deleting node's right)
-	//use subcessor to replace the deleting node's position
-        replace = replace->right;
-        while (replace->left != NULL)
-            replace = replace->left;
-
-        // if node is not root
-        if (rb_parent(node))
-        {
-            if (rb_parent(node)->left == node)
-                rb_parent(node)->left = replace;
-            else
-                rb_parent(node)->right = replace;
-        } 
-        else 
-            // if node is root node, replace root node
-            root->node = replace;
-
-        // change subcessor's right. Subcessor cannot have a left
-        child = replace->right;
-        parent = rb_parent(replace);
-        // save subsessor's color
-        color = rb_color(replace);
-
-        // if deleting node is parent to subcessor
-        if (parent == node)
-        {
-            parent = replace;
-        } 
-        else
-        {
-            // child exists
-            if (child)
-                rb_set_parent(child, parent);
-            parent->left = child;
-
-            replace->right = node->right;
-            rb_set_parent(node->right, replace);
-        }
-
-        replace->parent = node->parent;
-        replace->color = node->color;
-        replace->left = node->left;
-        node->left->parent = replace;
-
-        if (color == BLACK)
-            rbtree_delete_fixup(root, child, parent);
-        free(node);
-
-        return ;
-    }
-
-    if (node->left !=NULL)
-        child = node->left;
-    else 
-        child = node->right;
-
-    parent = node->parent;
-    // save color of new node
-    color = node->color;
-
-    if (child)
-        child->parent = parent;
-
-    // if node is not root node
-    if (parent)
-    {
-        if (parent->left == node)
-            parent->left = child;
-        else
-            parent->right = child;
-    }
-    else
-        root->node = child;
-
-    if (color == BLACK)
-        rbtree_delete_fixup(root, child, parent);
-    free(node);
-}
-
-/* Function:
- * deleting the node with start pointer ptr
- *
- * Parameters：
- *     tree 	RB Tree
- *     ptr	start address of node waiting to be deleted 
- */
-void delete_rbtree(RBRoot *root, void *ptr)
-{
-    Node *z; 
-
-    if ((z = search(root->node, ptr)) != NULL)
-        rbtree_delete(root, z);
-}
-
-
-/* Function:
- * fix function to fix color of RB tree.
- *
- *
- * Parameters：
- *     root	 RB Tree
- *     node	 node waiting to get inserted        
- */
-static void rbtree_insert_fixup(RBRoot *root, Node *node)
-{
-    Node *parent, *gparent;
-
-    // if father exists and father is red
-    while ((parent = rb_parent(node)) && rb_is_red(parent))
-    {
-        gparent = rb_parent(parent);
-	
-        //if father is left to grandpa
-        if (parent == gparent->left)
-        {
-            // Case 1： uncle is red
-            {
-                Node *uncle = gparent->right;
-                if (uncle && rb_is_red(uncle))
-                {
-                    rb_set_black(uncle);
-                    rb_set_black(parent);
-                    rb_set_red(gparent);
-                    node = gparent;
-                    continue;
-                }
-            }
-
-            // Case 2: uncle is black and current node is right of father
-            if (parent->right == node)
-            {
-                Node *tmp;
-                rbtree_left_rotate(root, parent);
-                tmp = parent;
-                parent = node;
-                node = tmp;
-            }
-
-            // Case 3: uncle is black and current node is the left of father
-            rb_set_black(parent);
-            rb_set_red(gparent);
-            rbtree_right_rotate(root, gparent);
-        } 
-        else//if father is right to grandpa
-        {
-            // Case 1: uncle is red
-            {
-                Node *uncle = gparent->left;
-                if (uncle && rb_is_red(uncle))
-                {
-                    rb_set_black(uncle);
-                    rb_set_black(parent);
-                    rb_set_red(gparent);
-                    node = gparent;
-                    continue;
-                }
-            }
-
-            // Case 2: uncle is black and current node is left of father
-            if (parent->left == node)
-            {
-                Node *tmp;
-                rbtree_right_rotate(root, parent);
-                tmp = parent;
-                parent = node;
-                node = tmp;
-            }
-
-            // Case 3: uncle is black and current node is right of father
-            rb_set_black(parent);
-            rb_set_red(gparent);
-            rbtree_left_rotate(root, gparent);
-        }
-    }
-
-    // set root color to be black
-    rb_set_black(root->node);
-}
-
-/*Define a data structure called deletelist which is to
- store all free but overlap tree nodes with the pending added treenode*/
-/*typedef struct deletelist{
-    int cap;
-    int size;
-    Node **list;
-}deletelist;*/
-
-/*
- * Function: traverse the subtree that has overlap
- * Parameters: the potential deletelist which is to store all free but overlap nodes
- *             the treenode
- *             the pending added node
- */
-static void nodeoverlap(Node *treenode, Node *newnode, delist *dl) {
-    if ((treenode == NULL)) {
-        return;
-    }
-    else {
-////
-    void *treestart = treenode->start;
-    void *treeend = treestart + treenode->size - 1;
-    void *newstart = newnode->start;
-    void *newend = newstart + newnode->size - 1;
-    //check whether there is any overlap between the pending add node and a treenode
-    int overlap = 0;
-    //if new's start is within tree's range
-    if (newstart <= treestart && treestart <= newend) {
-        overlap = 1;
-    }
-    //else tree's start is within new 's range
-    else {
-        if (newstart <= treeend && treeend <= newend) {
-            overlap = 2;
-        }
-	else if ((treestart < newstart) && (newend <= treeend)) {
-	    overlap = 3;
-        }
-    }
-////
-    if (overlap == 0){
-	return;
-    }else if (overlap != 1) {
-    //if there is some overlap but the treenode is allocated, exit
-	    if (treenode->freeFlag == 1) {
-		fprintf(stderr, "Error: there is some overlap between address %p with length %d and address %p with length %d", treenode->start, treenode->size, newnode->start, newnode->size);
-		exit(1);
-	    }
-	    else {
-		//shrink the free node's size so that it do not have any overlap with pending node
-		treenode->size = newnode->start-treenode->start;
-		// if the new node is within the treenode range, we do not need to do anything, just return. Else, we need to keep searching 
-		if (overlap == 2)
-			nodeoverlap(treenode->right, newnode, dl);
-		return;
-	    }
-	} else {//else corresponds to the case: overlap(treenode, newnode) == 1
-	    //if there is some overlap but the treenode is allocated, exit
-	    if (treenode->freeFlag == 1) {
-		fprintf(stderr, "Error: there is some overlap between address %p with length %d and address %p with length %d", treenode->start, treenode->size, newnode->start, newnode->size);
-		exit(1);
-	    }
-	    else {
-		//if deletelist is full, double capacity
-		if (dl->size >= dl->cap) {
-		    dl->cap = 2*dl->cap;
-		    dl->list = realloc(dl->list, dl->cap*sizeof(Node *));
-		}
-		//add overlap and free treenode to the delete list
-		dl->list[dl->size] = treenode;
-		dl->size++;
-		nodeoverlap(treenode->left, newnode, dl);
-		nodeoverlap(treenode->right, newnode, dl);
-		return;
-	    }
-        }
-    }
-}
-
-
-/*
- * Function：Add node into the rbtree
- *
- * Parameter Description：
- *     root root of the rbtree
- *     newNode node that wil be added into the rbtree
- */
-static void rbtree_insert(RBRoot *root, Node *newNode)
-{    
-    //record whether newNode is left of treeNode, 0->right, 1->left
-    int direction = 0;
-    Node *treeNode = root->node;
-    //record the parent node of treeNode
-    Node *buffer = NULL;
-    //get the start and end addr for newNode and root
-    void * treeNodeStart;
-    void * treeNodeEnd;
-    void * newNodeStart;
-    void * newNodeEnd;
-    while (treeNode != NULL) {  
-        treeNodeStart = treeNode->start;
-        treeNodeEnd = treeNodeStart + treeNode->size - 1;
-	newNodeStart = newNode->start;
-        newNodeEnd = newNodeStart + newNode->size - 1;
-        buffer = treeNode;
-        if (treeNodeStart > newNodeEnd) {
-		//newNode go to treeNodeStart's left
-                treeNode = treeNode->left;
-                direction = 1;
-        }
-        else {
-            if (treeNodeEnd < newNodeStart) {
-		//newNode go to treeNodeStart's right
-                treeNode = treeNode->right;
-                direction = 0;
-            }
-            else {
-                //need to check if the overlapped node has been freed
-		delist *dl;
-	        dl = (delist*)malloc(sizeof(delist));
-		dl->cap = buffersize;
-                dl->size = 0;
-                dl->list = malloc(dl->cap*sizeof(Node*));
-		//need to check if the overlapped node has been freed
-                nodeoverlap(treeNode, newNode, dl);
-                for (int i = 0; i < dl->size; i++) {
-                    //delete overlap free nodes
-                    //after each delete, the tree's colors will all change!
-                    rbtree_delete(root, dl->list[i]);
-                }
-		free(dl->list);
-		free(dl);
-                //add new node to the tree after clean the overlap free nodes
-                //if root is still here
-                if (root != NULL) {
-                    //re-run add new node function to add node
-                    rbtree_insert(root, newNode);
-                } else { //if all nodes on the tree have been deleted,new node should be new tree's root
-                    newNode->color = BLACK;
-		    root->node = newNode;
-		    
-                }
-                return;
-            }
-        }
-    }
-    rb_parent(newNode) = buffer;
-
-    //newNode will be the root if treeNode is NULL
-    if (buffer != NULL){
-        if (direction == 0) {
-            buffer->right = newNode;
-        }
-        else {
-            buffer->left = newNode;
-        }
-    }
-    else{
-        root->node = newNode;
-    }
-
-    // Set node color to RED
-    newNode->color = RED;
-
-    // fix-up the BST
-    rbtree_insert_fixup(root, newNode);
-    return;
-}
-
-
-
-
-
-
-
-
-
-/* FUnction:
- * create a node
- *
- * Parameters：
- *     size 	address size of the node
- *     ptr 	node's start address
- */
-static Node* create_rbtree_node(int size, void* ptr)
-{
-    Node* p;
-
-    if ((p = (Node *)malloc(sizeof(Node))) == NULL)
-        return NULL;
-    p->size = size;
-    p->left = NULL;
-    p->right = NULL;
-    p->parent = NULL;
-    p->color = RED; // initially set color of new node to be red
-    if (ptr == NULL){
-        p->start = malloc(size);  
-    }else{
-        p->start = ptr;
-    }                 
-    p->freeFlag = 1;
-
-    return p;
-}
-
-/* FUnction:
- * INsert node into the RB Tree
- *
- * Parameters：
- *     root	RB Tree
- *     size 	address size of the node
- *     ptr 	node's start address
- */
-Node* insert_rbtree(RBRoot *root, int size, void* ptr)
-{
-    Node *node;    // initiate new node
-    // if create new node failed, return NULL
-    if ((node=create_rbtree_node(size, ptr)) == NULL)
-        return NULL;
-    
-    rbtree_insert(root, node);
-
-    return node;
-}
-
-
-
-/* Function:
- * Print RB Tree
- *
- * Parameters:
- * tree       RB Tree
- * start       node's start pointer 
- * direction      0，print node itself
- *               -1，print node's left
- *                1，print node's right
- */
-static void rbtree_print(RBTree tree, void* start, int direction)
-{
-    if(tree != NULL)
-    {
-        if(direction==0)    // print node itself
-            printf("%2p(B) is root, freeFlag is %2d, size is %d \n", tree->start, tree->freeFlag, tree->size);
-        else                // print its left/right
-            printf("%2p(%s) is %2p's %6s child, freeFlag is %2d, size is %d\n", tree->start, rb_is_red(tree)?"R":"B", start, direction==1?"right" : "left", tree->freeFlag, tree->size);
-
-        rbtree_print(tree->left, tree->start, -1);
-        rbtree_print(tree->right,tree->start,  1);
-    }
-}
-
-void print_rbtree(RBRoot *root)
-{
-    if (root!=NULL && root->node!=NULL)
-        rbtree_print(root->node, root->node->start, 0);
-}
+/**
+ * Implementing Red-Black Tree by C
+ * The basic building steps of Red-BLack Tree is borrow from skywang 
+ * who generated the RedBlackTree library at https://www.cnblogs.com/skywang12345/p/3624177.html on 2013/11/18
+ * Yifan and Siyuan adds some codes to make sure the basic red black tree library works 
+ * for current oproject 4 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "range_tree.h"
+#include "dump537.h"
+
+/*define some RB Tree basic contents at the top*/
+#define rb_parent(r)   ((r)->parent)
+#define rb_color(r) ((r)->color)
+#define rb_is_red(r)   ((r)->color==RED)
+#define rb_is_black(r)  ((r)->color==BLACK)
+#define rb_set_black(r)  do {if (r) (r)->color = BLACK; } while (0)
+#define rb_set_red(r)  do {if (r) (r)->color = RED; } while (0)
+#define rb_set_parent(r,p)  do { if (r) (r)->parent = (p); } while (0)
+#define rb_set_color(r,c)  do { if (r) (r)->color = (c); } while (0)
+#define rb_max_epoch(r)  ((r) ? (r)->max_epoch : 0)
+//define a buffer size that we will use as the initialized capacity of delete list where we store the nodes needed to be deleted
+#define buffersize 32
+
+/*Function: 
+ * create a Red Black Tree and Return the root of a Red Black Tree
+ */
+RBRoot* create_rbtree()
+{
+    RBRoot *root = (RBRoot *)malloc(sizeof(RBRoot));
+    root->node = NULL;
+    root->spare = NULL;
+    root->blocks = NULL;
+    return root;
+}
+
+/*Nodes made by build_rbtree come in one block. They cannot be freed one by
+ one, so rbtree_delete puts them on the spare list of the tree and
+ insert_rbtree takes new nodes from there first.*/
+struct node_block{
+    struct node_block *next;
+    Node nodes[];
+};
+
+/* Function:
+ * Give back the memory of a node that has been unlinked from the tree
+ *
+ * Parameters:
+ * root       RB Tree
+ * node       the unlinked node
+ */
+static void release_node(RBRoot *root, Node *node)
+{
+    if (node->pooled)
+    {
+        node->left = root->spare;
+        root->spare = node;
+    }
+    else
+        free(node);
+}
+
+
+/* Function:
+ * Use recursion to search the RB Tree and find the node with start address, ptr
+ * 
+ * Parameters:
+ * x		the RB Tree
+ * ptr		the pointer of the node getting search
+ */
+static Node* search(RBTree x, void *ptr)
+{
+    if (x==NULL || x->start==ptr)
+        return x;
+
+    if (ptr < x->start)
+        return search(x->left, ptr);
+    else
+        return search(x->right, ptr);
+}
+
+int rbtree_search(RBRoot *root, void *ptr)
+{
+    if (root)
+        return search(root->node, ptr)? 0 : -1;
+    return -1;
+}
+
+
+
+/* Function:
+ * Recompute max_epoch of a node from its own epoch and its children
+ *
+ * Parameters:
+ * node       node whose children are up to date
+ */
+static void update_max_epoch(Node *node)
+{
+    unsigned long max = node->epoch;
+
+    if (rb_max_epoch(node->left) > max)
+        max = node->left->max_epoch;
+    if (rb_max_epoch(node->right) > max)
+        max = node->right->max_epoch;
+    node->max_epoch = max;
+}
+
+/* Function: 
+ * Do left rotation to RB Tree
+ *
+ * Here is how left rotation works for node x：
+ *      px                              px
+ *     /                               /
+ *    x                               y                
+ *   /  \     -(left rotation)->     / \               
+ *  lx   y                          x  ry     
+ *     /   \                       /  \
+ *    ly   ry                     lx  ly  
+ *
+ * Parameters:
+ * root:   RB tree
+ * x:	   node getting to be left rotate
+ */
+static void rbtree_left_rotate(RBRoot *root, Node *x)
+{
+    // let x's right to be y
+    Node *y = x->right;
+
+    // set y's left to be x's right
+    // if y's left exists, x to be y's left's new parent
+    x->right = y->left;
+    if (y->left != NULL)
+        y->left->parent = x;
+
+    // let x's parent to be y's parent
+    y->parent = x->parent;
+
+    if (x->parent == NULL)
+    {
+        root->node = y;            // if x does not have a patent, then y would be the root node
+    }
+    else
+    {
+        if (x->parent->left == x)
+            x->parent->left = y;    // if x is the left child of its parent, let y be x's parent's left child
+        else
+            x->parent->right = y;    // if x is the right child of its parent, let y be x's parent's right child
+    }
+    
+    // let y's left to be x
+    y->left = x;
+    // let x's parent to be y
+    x->parent = y;
+
+    // x is now below y
+    update_max_epoch(x);
+    update_max_epoch(y);
+}
+
+/* Function:
+ * Do right rotation to RB Tree
+ *
+ * Here is how right rotation works for node x：
+ *            py                               py
+ *           /                                /
+ *          y                                x                  
+ *         /  \    -(right rotation)->      /  \                    
+ *        x   ry                           lx   y  
+ *       / \                                   / \                  
+ *      lx  rx                                rx  ry
+ * Parameters:
+ * root:   RB tree
+ * x:	   node getting to be left rotate
+ */
+static void rbtree_right_rotate(RBRoot *root, Node *y)
+{
+    // set x to be y's left
+    Node *x = y->left;
+
+    // set x's right to be y's left
+    //if x's right exists, set x's right's parent to be y
+    y->left = x->right;
+    if (x->right != NULL)
+        x->right->parent = y;
+
+    // set y's parent to be x's parent
+    x->parent = y->parent;
+
+    if (y->parent == NULL) 
+    {
+        root->node = x;            // if y's parent does not exist, set x to be the root node
+    }
+    else
+    {
+        if (y == y->parent->right)
+            y->parent->right = x;    // if y is its parent's right, set y's parent's right to be x
+        else
+            y->parent->left = x;    // set y's parent's left to be x
+    }
+
+    // set x's right to be y
+    x->right = y;
+
+    // set y's parent to be x
+    y->parent = x;
+
+    // y is now below x
+    update_max_epoch(y);
+    update_max_epoch(x);
+}
+
+/* Function:
+ * Fixup function for the deletion of RB Tree
+ *
+ * After RB tree finish its deletion, and its balance cannot keep, 
+ * call this function to fix the balance so that we reget a RB Tree
+ *
+ * Parameters：
+ *     root   RB Tree's root
+ *     node   node waiting to be fixed
+ */
+static void rbtree_delete_fixup(RBRoot *root, Node *node, Node *parent)
+{
+    Node *other;
+
+    while ((!node || rb_is_black(node)) && node != root->node)
+    {
+        if (parent->left == node)
+        {
+            other = parent->right;
+            if (rb_is_red(other))
+            {
+                // Case 1: x's sibling is red  
+                rb_set_black(other);
+                rb_set_red(parent);
+                rbtree_left_rotate(root, parent);
+                other = parent->right;
+            }
+            if ((!other->left || rb_is_black(other->left)) &&
+                (!other->right || rb_is_black(other->right)))
+            {
+                // Case 2: x's sibling + x's newphews are black 
+                rb_set_red(other);
+                node = parent;
+                parent = rb_parent(node);
+            }
+            else
+            {
+                if (!other->right || rb_is_black(other->right))
+                {
+                    // Case 3: x's sibling is black, x's left newphew is red, x's right newphew is black  
+                    rb_set_black(other->left);
+                    rb_set_red(other);
+                    rbtree_right_rotate(root, other);
+                    other = parent->right;
+                }
+                // Case 4: x's sibling is black, x's right newphew is red
+                rb_set_color(other, rb_color(parent));
+                rb_set_black(parent);
+                rb_set_black(other->right);
+                rbtree_left_rotate(root, parent);
+                node = root->node;
+                break;
+            }
+        }
+        else
+        {
+            other = parent->left;
+            if (rb_is_red(other))
+            {
+                // Case 1: x's sibling is red 
+                rb_set_black(other);
+                rb_set_red(parent);
+                rbtree_right_rotate(root, parent);
+                other = parent->left;
+            }
+            if ((!other->left || rb_is_black(other->left)) &&
+                (!other->right || rb_is_black(other->right)))
+            {
+                // Case 2: Case 2: x's sibling + x's newphews are black 
+                rb_set_red(other);
+                node = parent;
+                parent = rb_parent(node);
+            }
+            else
+            {
+                if (!other->left || rb_is_black(other->left))
+                {
+                    // Case 3:x's sibling is black, x's left newphew is red, x's right newphew is black   
+                    rb_set_black(other->right);
+                    rb_set_red(other);
+                    rbtree_left_rotate(root, other);
+                    other = parent->left;
+                }
+                // Case 4:x's sibling is black, x's right newphew is red
+                rb_set_color(other, rb_color(parent));
+                rb_set_black(parent);
+                rb_set_black(other->left);
+                rbtree_right_rotate(root, parent);
+                node = root->node;
+                break;
+            }
+        }
+    }
+    if (node)
+        rb_set_black(node);
+}
+
+/* Function:
+ * Deleting a node from RB Tree
+ *
+ * Parameters：
+ *     tree 	RB Tree
+ *     node 	node waiting to be deleted
+ */
+void rbtree_delete(RBRoot *root, Node *node)
+{
+    Node *child, *parent, *other;
+    int color;
+
+    // if node has 2 children
+    if ( (node->left!=NULL) && (node->right!=NULL) ) 
+    {
+        Node *replace = node;
+
+        // get subcessor(deleting node's right)
+	//use subcessor to replace the deleting node's position
+        replace = replace->right;
+        while (replace->left != NULL)
+            replace = replace->left;
+
+        // if node is not root
+        if (rb_parent(node))
+        {
+            if (rb_parent(node)->left == node)
+                rb_parent(node)->left = replace;
+            else
+                rb_parent(node)->right = replace;
+        } 
+        else 
+            // if node is root node, replace root node
+            root->node = replace;
+
+        // change subcessor's right. Subcessor cannot have a left
+        child = replace->right;
+        parent = rb_parent(replace);
+        // save subsessor's color
+        color = rb_color(replace);
+
+        // if deleting node is parent to subcessor
+        if (parent == node)
+        {
+            parent = replace;
+        } 
+        else
+        {
+            // child exists
+            if (child)
+                rb_set_parent(child, parent);
+            parent->left = child;
+
+            replace->right = node->right;
+            rb_set_parent(node->right, replace);
+        }
+
+        replace->parent = node->parent;
+        replace->color = node->color;
+        replace->left = node->left;
+        node->left->parent = replace;
+
+        for (other = parent; other != NULL; other = other->parent)
+            update_max_epoch(other);
+        if (color == BLACK)
+            rbtree_delete_fixup(root, child, parent);
+        release_node(root, node);
+
+        return ;
+    }
+
+    if (node->left !=NULL)
+        child = node->left;
+    else 
+        child = node->right;
+
+    parent = node->parent;
+    // save color of new node
+    color = node->color;
+
+    if (child)
+        child->parent = parent;
+
+    // if node is not root node
+    if (parent)
+    {
+        if (parent->left == node)
+            parent->left = child;
+        else
+            parent->right = child;
+    }
+    else
+        root->node = child;
+
+    for (other = parent; other != NULL; other = other->parent)
+        update_max_epoch(other);
+    if (color == BLACK)
+        rbtree_delete_fixup(root, child, parent);
+    release_node(root, node);
+}
+
+/* Function:
+ * deleting the node with start pointer ptr
+ *
+ * Parameters：
+ *     tree 	RB Tree
+ *     ptr	start address of node waiting to be deleted 
+ */
+void delete_rbtree(RBRoot *root, void *ptr)
+{
+    Node *z; 
+
+    if ((z = search(root->node, ptr)) != NULL)
+        rbtree_delete(root, z);
+}
+
+
+/* Function:
+ * fix function to fix color of RB tree.
+ *
+ *
+ * Parameters：
+ *     root	 RB Tree
+ *     node	 node waiting to get inserted        
+ */
+static void rbtree_insert_fixup(RBRoot *root, Node *node)
+{
+    Node *parent, *gparent;
+
+    // if father exists and father is red
+    while ((parent = rb_parent(node)) && rb_is_red(parent))
+    {
+        gparent = rb_parent(parent);
+	
+        //if father is left to grandpa
+        if (parent == gparent->left)
+        {
+            // Case 1： uncle is red
+            {
+                Node *uncle = gparent->right;
+                if (uncle && rb_is_red(uncle))
+                {
+                    rb_set_black(uncle);
+                    rb_set_black(parent);
+                    rb_set_red(gparent);
+                    node = gparent;
+                    continue;
+                }
+            }
+
+            // Case 2: uncle is black and current node is right of father
+            if (parent->right == node)
+            {
+                Node *tmp;
+                rbtree_left_rotate(root, parent);
+                tmp = parent;
+                parent = node;
+                node = tmp;
+            }
+
+            // Case 3: uncle is black and current node is the left of father
+            rb_set_black(parent);
+            rb_set_red(gparent);
+            rbtree_right_rotate(root, gparent);
+        } 
+        else//if father is right to grandpa
+        {
+            // Case 1: uncle is red
+            {
+                Node *uncle = gparent->left;
+                if (uncle && rb_is_red(uncle))
+                {
+                    rb_set_black(uncle);
+                    rb_set_black(parent);
+                    rb_set_red(gparent);
+                    node = gparent;
+                    continue;
+                }
+            }
+
+            // Case 2: uncle is black and current node is left of father
+            if (parent->left == node)
+            {
+                Node *tmp;
+                rbtree_right_rotate(root, parent);
+                tmp = parent;
+                parent = node;
+                node = tmp;
+            }
+
+            // Case 3: uncle is black and current node is right of father
+            rb_set_black(parent);
+            rb_set_red(gparent);
+            rbtree_left_rotate(root, gparent);
+        }
+    }
+
+    // set root color to be black
+    rb_set_black(root->node);
+}
+
+/*Define a data structure called deletelist which is to
+ store all free but overlap tree nodes with the pending added treenode*/
+/*typedef struct deletelist{
+    int cap;
+    int size;
+    Node **list;
+}deletelist;*/
+
+/*
+ * Function: traverse the subtree that has overlap
+ * Parameters: the potential deletelist which is to store all free but overlap nodes
+ *             the treenode
+ *             the pending added node
+ */
+static void nodeoverlap(Node *treenode, Node *newnode, delist *dl) {
+    if ((treenode == NULL)) {
+        return;
+    }
+    else {
+////
+    void *treestart = treenode->start;
+    void *treeend = treestart + treenode->size - 1;
+    void *newstart = newnode->start;
+    void *newend = newstart + newnode->size - 1;
+    //check whether there is any overlap between the pending add node and a treenode
+    int overlap = 0;
+    //if new's start is within tree's range
+    if (newstart <= treestart && treestart <= newend) {
+        overlap = 1;
+    }
+    //else tree's start is within new 's range
+    else {
+        if (newstart <= treeend && treeend <= newend) {
+            overlap = 2;
+        }
+	else if ((treestart < newstart) && (newend <= treeend)) {
+	    overlap = 3;
+        }
+    }
+////
+    if (overlap == 0){
+	return;
+    }else if (overlap != 1) {
+    //if there is some overlap but the treenode is allocated, exit
+	    if (treenode->freeFlag == 1) {
+		fprintf(stderr, "Error: there is some overlap between address %p with length %zu and address %p with length %zu", treenode->start, treenode->size, newnode->start, newnode->size);
+		exit(1);
+	    }
+	    else {
+		//shrink the free node's size so that it do not have any overlap with pending node
+		treenode->size = newnode->start-treenode->start;
+		// if the new node is within the treenode range, we do not need to do anything, just return. Else, we need to keep searching 
+		if (overlap == 2)
+			nodeoverlap(treenode->right, newnode, dl);
+		return;
+	    }
+	} else {//else corresponds to the case: overlap(treenode, newnode) == 1
+	    //if there is some overlap but the treenode is allocated, exit
+	    if (treenode->freeFlag == 1) {
+		fprintf(stderr, "Error: there is some overlap between address %p with length %zu and address %p with length %zu", treenode->start, treenode->size, newnode->start, newnode->size);
+		exit(1);
+	    }
+	    else {
+		//if deletelist is full, double capacity
+		if (dl->size >= dl->cap) {
+		    dl->cap = 2*dl->cap;
+		    dl->list = realloc(dl->list, dl->cap*sizeof(Node *));
+		}
+		//add overlap and free treenode to the delete list
+		dl->list[dl->size] = treenode;
+		dl->size++;
+		nodeoverlap(treenode->left, newnode, dl);
+		nodeoverlap(treenode->right, newnode, dl);
+		return;
+	    }
+        }
+    }
+}
+
+
+/*
+ * Function：Add node into the rbtree
+ *
+ * Parameter Description：
+ *     root root of the rbtree
+ *     newNode node that wil be added into the rbtree
+ */
+static void rbtree_insert(RBRoot *root, Node *newNode)
+{    
+    //record whether newNode is left of treeNode, 0->right, 1->left
+    int direction = 0;
+    Node *treeNode = root->node;
+    //record the parent node of treeNode
+    Node *buffer = NULL;
+    //get the start and end addr for newNode and root
+    void * treeNodeStart;
+    void * treeNodeEnd;
+    void * newNodeStart;
+    void * newNodeEnd;
+    while (treeNode != NULL) {  
+        treeNodeStart = treeNode->start;
+        treeNodeEnd = treeNodeStart + treeNode->size - 1;
+	newNodeStart = newNode->start;
+        newNodeEnd = newNodeStart + newNode->size - 1;
+        buffer = treeNode;
+        if (treeNodeStart > newNodeEnd) {
+		//newNode go to treeNodeStart's left
+                treeNode = treeNode->left;
+                direction = 1;
+        }
+        else {
+            if (treeNodeEnd < newNodeStart) {
+		//newNode go to treeNodeStart's right
+                treeNode = treeNode->right;
+                direction = 0;
+            }
+            else {
+                //need to check if the overlapped node has been freed
+		delist *dl;
+	        dl = (delist*)malloc(sizeof(delist));
+		dl->cap = buffersize;
+                dl->size = 0;
+                dl->list = malloc(dl->cap*sizeof(Node*));
+		//need to check if the overlapped node has been freed
+                nodeoverlap(treeNode, newNode, dl);
+                for (int i = 0; i < dl->size; i++) {
+                    //delete overlap free nodes
+                    //after each delete, the tree's colors will all change!
+                    rbtree_delete(root, dl->list[i]);
+                }
+		free(dl->list);
+		free(dl);
+                //add new node to the tree after clean the overlap free nodes
+                //if root is still here
+                if (root != NULL) {
+                    //re-run add new node function to add node
+                    rbtree_insert(root, newNode);
+                } else { //if all nodes on the tree have been deleted,new node should be new tree's root
+                    newNode->color = BLACK;
+		    root->node = newNode;
+		    
+                }
+                return;
+            }
+        }
+    }
+    rb_parent(newNode) = buffer;
+
+    // the new node has the newest epoch of the tree, so it is the max of all its ancestors
+    for (treeNode = buffer; treeNode != NULL; treeNode = treeNode->parent)
+        treeNode->max_epoch = newNode->epoch;
+
+    //newNode will be the root if treeNode is NULL
+    if (buffer != NULL){
+        if (direction == 0) {
+            buffer->right = newNode;
+        }
+        else {
+            buffer->left = newNode;
+        }
+    }
+    else{
+        root->node = newNode;
+    }
+
+    // Set node color to RED
+    newNode->color = RED;
+
+    // fix-up the BST
+    rbtree_insert_fixup(root, newNode);
+    return;
+}
+
+
+
+
+
+
+
+
+
+/* FUnction:
+ * create a node
+ *
+ * Parameters：
+ *     root	RB Tree, whose spare nodes are used first
+ *     size 	address size of the node
+ *     ptr 	node's start address
+ */
+static Node* create_rbtree_node(RBRoot *root, size_t size, void* ptr)
+{
+    Node* p;
+
+    if ((p = root->spare) != NULL)
+        root->spare = p->left;
+    else if ((p = (Node *)malloc(sizeof(Node))) == NULL)
+        return NULL;
+    else
+        p->pooled = 0;
+    p->size = size;
+    p->left = NULL;
+    p->right = NULL;
+    p->parent = NULL;
+    p->color = RED; // initially set color of new node to be red
+    if (ptr == NULL){
+        if ((p->start = malloc(size)) == NULL){
+            release_node(root, p);
+            return NULL;
+        }
+    }else{
+        p->start = ptr;
+    }                 
+    p->freeFlag = 1;
+    p->epoch = p->max_epoch = ++root->epoch;
+    p->scope_next = NULL;
+    p->scope_pprev = NULL;
+
+    return p;
+}
+
+/* FUnction:
+ * INsert node into the RB Tree
+ *
+ * Parameters：
+ *     root	RB Tree
+ *     size 	address size of the node
+ *     ptr 	node's start address
+ */
+Node* insert_rbtree(RBRoot *root, size_t size, void* ptr)
+{
+    Node *node;    // initiate new node
+    // if create new node failed, return NULL
+    if ((node=create_rbtree_node(root, size, ptr)) == NULL)
+        return NULL;
+    
+    rbtree_insert(root, node);
+
+    return node;
+}
+
+
+
+/* Function:
+ * Build a balanced subtree from the first n nodes of a list linked through left
+ *
+ * The list is split in the middle at every level, so the two subtrees of any
+ * node differ by at most one node and all NULL links are on the last two
+ * levels. Coloring the last level red when it is not full, and everything
+ * else black, then gives every path the same number of black nodes.
+ * Recursion depth is log(n).
+ *
+ * Parameters:
+ * list       head of the list, advanced past the used nodes
+ * n          number of nodes in the subtree
+ * depth      depth of the subtree root, 0 for the root of the tree
+ * reddepth   depth of the red level, -1 if the tree is perfect
+ * parent     parent of the subtree root
+ */
+static Node* build_balanced(Node **list, int n, int depth, int reddepth, Node *parent)
+{
+    Node *left, *node;
+
+    if (n <= 0)
+        return NULL;
+
+    left = build_balanced(list, n / 2, depth + 1, reddepth, NULL);
+    node = *list;
+    *list = node->left;
+
+    node->parent = parent;
+    node->left = left;
+    if (left != NULL)
+        left->parent = node;
+    node->color = depth == reddepth ? RED : BLACK;
+    node->right = build_balanced(list, n - n / 2 - 1, depth + 1, reddepth, node);
+    update_max_epoch(node);
+    return node;
+}
+
+/* Function:
+ * Make a balanced RB Tree out of n nodes in address order, linked through left
+ *
+ * Parameters:
+ * root       RB Tree, must be empty
+ * list       first node
+ * n          number of nodes
+ */
+static void build_from_list(RBRoot *root, Node *list, int n)
+{
+    unsigned long m = n;        // unsigned long, so 2 << depth and n + 1 cannot overflow for any int n
+    int depth = 0, reddepth;
+
+    // depth of the last level is floor(log2(n)), it is full if n+1 is a power of 2
+    while ((2UL << depth) <= m)
+        depth++;
+    reddepth = ((m + 1) & m) == 0 ? -1 : depth;
+    root->node = build_balanced(&list, n, 0, reddepth, NULL);
+}
+
+/* Function:
+ * Build a RB Tree from ranges sorted by start in O(n)
+ *
+ * All nodes are allocated in one block. Like nodeoverlap, a freed range
+ * that runs into the next range is shrunk to end before it, and a freed
+ * range that starts inside an allocated one is dropped. Returns NULL if the
+ * ranges are not sorted, two allocated ranges overlap, or there is no memory.
+ *
+ * Parameters:
+ * ranges     ranges sorted by start
+ * n          number of ranges
+ */
+RBRoot* build_rbtree(const Range *ranges, int n)
+{
+    struct node_block *block;
+    RBRoot *root;
+    Node *node, *prev = NULL;
+    int i, count = 0;
+
+    if ((root = create_rbtree()) == NULL)
+        return NULL;
+    if (n <= 0)
+        return root;
+    if ((block = malloc(sizeof(struct node_block) + n * sizeof(Node))) == NULL)
+    {
+        free(root);
+        return NULL;
+    }
+    block->next = NULL;
+    root->blocks = block;
+
+    for (i = 0; i < n; i++)
+    {
+        const Range *r = &ranges[i];
+
+        if (prev != NULL && r->start < prev->start)
+        {
+            destroy_rbtree(root);
+            return NULL;
+        }
+        if (prev != NULL && r->start <= prev->start + prev->size - 1)
+        {
+            if (prev->freeFlag == 1 && r->freeFlag == 1)
+            {
+                destroy_rbtree(root);
+                return NULL;
+            }
+            if (prev->freeFlag == 1)
+                continue;               // freed range starting inside an allocated one
+            if (r->start == prev->start)
+                count--;                // freed range left with no bytes, reuse its node
+            else
+                prev->size = r->start - prev->start;
+        }
+        node = &block->nodes[count++];
+        node->pooled = 1;
+        node->start = r->start;
+        node->size = r->size;
+        node->freeFlag = r->freeFlag;
+        node->scope_next = NULL;
+        node->scope_pprev = NULL;
+        node->epoch = node->free_epoch = 0;     // older than any snapshot of the new tree
+        node->left = &block->nodes[count];    // list link for build_from_list
+        prev = node;
+    }
+    // nodes dropped above go on the spare list
+    for (i = count; i < n; i++)
+    {
+        block->nodes[i].pooled = 1;
+        release_node(root, &block->nodes[i]);
+    }
+    build_from_list(root, block->nodes, count);
+    return root;
+}
+
+/* Function:
+ * Chain all nodes in address order through left, without recursion
+ *
+ * The walk only reads the left pointer of a node before visiting it, so the
+ * left pointer of a visited node can be reused as the list link.
+ *
+ * Parameters:
+ * root       RB Tree
+ * live       set to the list of allocated nodes
+ * freed      set to the list of freed nodes
+ * Returns the number of allocated nodes
+ */
+static int rbtree_unlink_all(RBRoot *root, Node **live, Node **freed)
+{
+    Node *node, *next, *livetail = NULL, *freedtail = NULL;
+    int n = 0;
+
+    *live = *freed = NULL;
+    for (node = rbtree_first(root); node != NULL; node = next)
+    {
+        next = rbtree_next(node);
+        if (node->freeFlag == 1)
+        {
+            if (livetail != NULL)
+                livetail->left = node;
+            else
+                *live = node;
+            livetail = node;
+            n++;
+        }
+        else
+        {
+            if (freedtail != NULL)
+                freedtail->left = node;
+            else
+                *freed = node;
+            freedtail = node;
+        }
+    }
+    if (livetail != NULL)
+        livetail->left = NULL;
+    if (freedtail != NULL)
+        freedtail->left = NULL;
+    root->node = NULL;
+    return n;
+}
+
+/* Function:
+ * Drop every freed node and rebuild the rest into a balanced tree in O(n)
+ *
+ * The allocated nodes are relinked in place, they do not move. A block whose
+ * node is dropped here is no longer known at all, so a later free537 of it
+ * is reported as never allocated instead of as a double free.
+ *
+ * Parameters:
+ * root       RB Tree
+ */
+void rbtree_compact(RBRoot *root)
+{
+    Node *live, *freed, *next;
+    int n;
+
+    if (root == NULL)
+        return;
+    n = rbtree_unlink_all(root, &live, &freed);
+    for (; freed != NULL; freed = next)
+    {
+        next = freed->left;
+        release_node(root, freed);
+    }
+    build_from_list(root, live, n);
+}
+
+/* Function:
+ * Free a RB Tree and all of its nodes, not the memory the nodes describe
+ *
+ * Parameters:
+ * root       RB Tree
+ */
+void destroy_rbtree(RBRoot *root)
+{
+    Node *live, *freed, *next;
+    struct node_block *block, *nextblock;
+
+    if (root == NULL)
+        return;
+    rbtree_unlink_all(root, &live, &freed);
+    for (; live != NULL; live = next)
+    {
+        next = live->left;
+        if (!live->pooled)
+            free(live);
+    }
+    for (; freed != NULL; freed = next)
+    {
+        next = freed->left;
+        if (!freed->pooled)
+            free(freed);
+    }
+    for (block = root->blocks; block != NULL; block = nextblock)
+    {
+        nextblock = block->next;
+        free(block);
+    }
+    free(root);
+}
+
+/* Function:
+ * Print RB Tree
+ *
+ * Parameters:
+ * tree       RB Tree
+ * start       node's start pointer 
+ * direction      0，print node itself
+ *               -1，print node's left
+ *                1，print node's right
+ */
+static void rbtree_print(RBTree tree, void* start, int direction)
+{
+    if(tree != NULL)
+    {
+        if(direction==0)    // print node itself
+            printf("%2p(B) is root, freeFlag is %2d, size is %zu \n", tree->start, tree->freeFlag, tree->size);
+        else                // print its left/right
+            printf("%2p(%s) is %2p's %6s child, freeFlag is %2d, size is %zu\n", tree->start, rb_is_red(tree)?"R":"B", start, direction==1?"right" : "left", tree->freeFlag, tree->size);
+
+        rbtree_print(tree->left, tree->start, -1);
+        rbtree_print(tree->right,tree->start,  1);
+    }
+}
+
+void print_rbtree(RBRoot *root)
+{
+    if (root!=NULL && root->node!=NULL)
+        rbtree_print(root->node, root->node->start, 0);
+}
+
+/* Function:
+ * Return the node with the lowest start address
+ *
+ * Parameters:
+ * root       RB Tree
+ */
+Node* rbtree_first(RBRoot *root)
+{
+    Node *node;
+
+    if (root == NULL || (node = root->node) == NULL)
+        return NULL;
+    while (node->left != NULL)
+        node = node->left;
+    return node;
+}
+
+/* Function:
+ * Return the in-order successor of node
+ *
+ * Walks with the parent pointers only, so a full traversal started from
+ * rbtree_first needs no recursion and no extra memory, and touches every
+ * edge at most twice.
+ *
+ * Parameters:
+ * node       current node
+ */
+Node* rbtree_next(Node *node)
+{
+    Node *parent;
+
+    // successor is the leftmost node of the right subtree
+    if (node->right != NULL)
+    {
+        node = node->right;
+        while (node->left != NULL)
+            node = node->left;
+        return node;
+    }
+
+    // otherwise climb until we come up from a left child
+    parent = node->parent;
+    while (parent != NULL && node == parent->right)
+    {
+        node = parent;
+        parent = parent->parent;
+    }
+    return parent;
+}
+
+/* Function:
+ * Return the in-order predecessor of node, the mirror of rbtree_next
+ *
+ * Parameters:
+ * node       current node
+ */
+Node* rbtree_prev(Node *node)
+{
+    Node *parent;
+
+    // predecessor is the rightmost node of the left subtree
+    if (node->left != NULL)
+    {
+        node = node->left;
+        while (node->right != NULL)
+            node = node->right;
+        return node;
+    }
+
+    // otherwise climb until we come up from a right child
+    parent = node->parent;
+    while (parent != NULL && node == parent->left)
+    {
+        node = parent;
+        parent = parent->parent;
+    }
+    return parent;
+}
+
+#define rb_matches(n, filter)  ((filter) & ((n)->freeFlag == 1 ? RB_LIVE : RB_FREED))
+
+/* Function:
+ * Put the cursor on the first block matching filter whose range ends at or
+ * after addr, so a block holding addr is included. One descent of the tree;
+ * the following rbcursor_next calls cost O(1) amortized each, so listing
+ * the k blocks of an address window costs O(log n + k), where k also counts
+ * the blocks the filter skips.
+ *
+ *     for (n = rbcursor_seek(&cur, root, lo, RB_LIVE); n && n->start < hi; n = rbcursor_next(&cur))
+ *
+ * Parameters:
+ * cur        cursor to set
+ * root       RB Tree
+ * addr       lowest address of interest
+ * filter     RB_LIVE, RB_FREED or RB_ALL
+ */
+Node* rbcursor_seek(RBCursor *cur, RBRoot *root, void *addr, int filter)
+{
+    Node *node = root ? root->node : NULL, *best = NULL;
+
+    while (node != NULL)
+    {
+        if (node->start + node->size - 1 >= addr)
+        {
+            best = node;
+            node = node->left;
+        }
+        else
+            node = node->right;
+    }
+    while (best != NULL && !rb_matches(best, filter))
+        best = rbtree_next(best);
+    cur->node = best;
+    cur->filter = filter;
+    return best;
+}
+
+/* Function:
+ * Move the cursor to the next block matching its filter
+ *
+ * Parameters:
+ * cur        cursor, NULL node stays NULL
+ */
+Node* rbcursor_next(RBCursor *cur)
+{
+    Node *node = cur->node;
+
+    if (node == NULL)
+        return NULL;
+    do
+        node = rbtree_next(node);
+    while (node != NULL && !rb_matches(node, cur->filter));
+    return cur->node = node;
+}
+
+/* Function:
+ * Move the cursor to the previous block matching its filter
+ *
+ * Parameters:
+ * cur        cursor, NULL node stays NULL
+ */
+Node* rbcursor_prev(RBCursor *cur)
+{
+    Node *node = cur->node;
+
+    if (node == NULL)
+        return NULL;
+    do
+        node = rbtree_prev(node);
+    while (node != NULL && !rb_matches(node, cur->filter));
+    return cur->node = node;
+}
+
+/* Function:
+ * Leftmost node inserted after epoch in a subtree whose max_epoch is newer
+ *
+ * Parameters:
+ * node       subtree root, node->max_epoch > epoch
+ * epoch      snapshot epoch
+ */
+static Node* leftmost_since(Node *node, unsigned long epoch)
+{
+    for (;;)
+    {
+        if (rb_max_epoch(node->left) > epoch)
+            node = node->left;
+        else if (node->epoch > epoch)
+            return node;
+        else
+            node = node->right;     // the newer node must be on the right
+    }
+}
+
+/* Function:
+ * Return the first node, in address order, inserted after epoch
+ *
+ * Together with rbtree_next_since this lists the nodes inserted since a
+ * snapshot without entering subtrees whose max_epoch says they hold nothing
+ * newer, so k new nodes in a big, mostly old tree cost O(k log n).
+ *
+ * Parameters:
+ * root       RB Tree
+ * epoch      snapshot epoch
+ */
+Node* rbtree_first_since(RBRoot *root, unsigned long epoch)
+{
+    if (root == NULL || rb_max_epoch(root->node) <= epoch)
+        return NULL;
+    return leftmost_since(root->node, epoch);
+}
+
+/* Function:
+ * Return the next node after node, in address order, inserted after epoch
+ *
+ * Parameters:
+ * node       current node
+ * epoch      snapshot epoch
+ */
+Node* rbtree_next_since(Node *node, unsigned long epoch)
+{
+    Node *parent;
+
+    if (rb_max_epoch(node->right) > epoch)
+        return leftmost_since(node->right, epoch);
+
+    // climb; a parent reached from its left child and its right subtree are still to visit
+    for (parent = node->parent; parent != NULL; node = parent, parent = parent->parent)
+    {
+        if (node != parent->left)
+            continue;
+        if (parent->epoch > epoch)
+            return parent;
+        if (rb_max_epoch(parent->right) > epoch)
+            return leftmost_since(parent->right, epoch);
+    }
+    return NULL;
+}
+
+/* Function:
+ * Check one subtree for rbtree_verify and return its black height, -1 on error
+ *
+ * Recursion depth is the tree height, which the invariants keep at 2log(n)
+ *
+ * Parameters:
+ * node       subtree root
+ */
+static int verify(Node *node)
+{
+    unsigned long max;
+    int lh, rh;
+
+    if (node == NULL)
+        return 1;
+    if (rb_is_red(node) && ((node->left && rb_is_red(node->left)) || (node->right && rb_is_red(node->right))))
+    {
+        fprintf(stderr, "rbtree_verify: red node %p has a red child\n", node->start);
+        return -1;
+    }
+    if ((node->left && node->left->parent != node) || (node->right && node->right->parent != node))
+    {
+        fprintf(stderr, "rbtree_verify: a child of %p has a wrong parent pointer\n", node->start);
+        return -1;
+    }
+    if ((lh = verify(node->left)) < 0 || (rh = verify(node->right)) < 0)
+        return -1;
+    max = node->epoch;
+    if (rb_max_epoch(node->left) > max)
+        max = node->left->max_epoch;
+    if (rb_max_epoch(node->right) > max)
+        max = node->right->max_epoch;
+    if (node->max_epoch != max)
+    {
+        fprintf(stderr, "rbtree_verify: max_epoch of %p is out of date\n", node->start);
+        return -1;
+    }
+    if (lh != rh)
+    {
+        fprintf(stderr, "rbtree_verify: black height %d on the left of %p but %d on the right\n", lh, node->start, rh);
+        return -1;
+    }
+    return lh + rb_is_black(node);
+}
+
+/* Function:
+ * Check that the tree is a valid red-black tree whose ranges are in
+ * ascending address order and do not overlap. Problems are reported on stderr.
+ *
+ * Parameters:
+ * root       RB Tree
+ */
+int rbtree_verify(RBRoot *root)
+{
+    Node *node, *next;
+
+    if (root == NULL || root->node == NULL)
+        return 0;
+    if (root->node->parent != NULL || rb_is_red(root->node))
+    {
+        fprintf(stderr, "rbtree_verify: root %p is red or has a parent\n", root->node->start);
+        return -1;
+    }
+    if (verify(root->node) < 0)
+        return -1;
+    for (node = rbtree_first(root); (next = rbtree_next(node)) != NULL; node = next)
+    {
+        if (node->start + node->size - 1 >= next->start)
+        {
+            fprintf(stderr, "rbtree_verify: range %p+%zu runs into range %p+%zu\n",
+                node->start, node->size, next->start, next->size);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// records written by rbtree_dump per write()
+#define DUMP_RECORDS 16384
+
+// write all len bytes of buf to fd, 0 on success, -1 on error
+static int write_all(int fd, const void *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0)
+    {
+        if ((n = write(fd, buf, len)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf = (const char *)buf + n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Function:
+ * Write the tree to fd in the binary format of dump537.h, in address order
+ *
+ * The walk goes through the parent pointers, so it needs no stack however
+ * deep the tree is, and the records go out DUMP_RECORDS at a time.
+ *
+ * Parameters:
+ * root       RB Tree, may be NULL or empty
+ * fd         file descriptor open for writing
+ * Returns 0 on success, -1 if a write failed or there is no memory for the buffer
+ */
+int rbtree_dump(RBRoot *root, int fd)
+{
+    dump537_header hdr;
+    dump537_record *buf;
+    Node *node = root != NULL ? root->node : NULL;
+    uint32_t depth = 0;
+    size_t n = 0;
+    int ret = 0;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DUMP537_MAGIC, sizeof(hdr.magic));
+    hdr.version = DUMP537_VERSION;
+    hdr.record_size = sizeof(dump537_record);
+    if ((buf = malloc(DUMP_RECORDS * sizeof(dump537_record))) == NULL)
+        return -1;
+    if (write_all(fd, &hdr, sizeof(hdr)) < 0)
+    {
+        free(buf);
+        return -1;
+    }
+
+    // in-order walk, depth follows every step down and up
+    for (; node != NULL && node->left != NULL; depth++)
+        node = node->left;
+    while (node != NULL && ret == 0)
+    {
+        buf[n].start = (uintptr_t)node->start;
+        buf[n].size = node->size;
+        buf[n].flags = (node->freeFlag == 1 ? DUMP537_LIVE : 0) | (rb_is_red(node) ? DUMP537_RED : 0);
+        buf[n].depth = depth;
+        if (++n == DUMP_RECORDS)
+        {
+            ret = write_all(fd, buf, n * sizeof(dump537_record));
+            n = 0;
+        }
+        if (node->right != NULL)
+        {
+            node = node->right;
+            for (depth++; node->left != NULL; depth++)
+                node = node->left;
+        }
+        else
+        {
+            while (node->parent != NULL && node == node->parent->right)
+            {
+                node = node->parent;
+                depth--;
+            }
+            node = node->parent;
+            depth--;
+        }
+    }
+    if (ret == 0 && n > 0)
+        ret = write_all(fd, buf, n * sizeof(dump537_record));
+    free(buf);
+    return ret;
+}
+
+/* Function:
+ * Map a file written by rbtree_dump and build a new balanced tree from it
+ *
+ * Only the ranges and their freeFlag are kept, the colors and depths of the
+ * dumped tree are for offline analysis and the new tree gets its own shape.
+ *
+ * Parameters:
+ * fd         file descriptor of the dump, open for reading
+ * Returns the new tree, or NULL if fd is not a dump, its ranges overlap or there is no memory
+ */
+RBRoot* load_rbtree(int fd)
+{
+    const dump537_header *hdr;
+    const dump537_record *rec;
+    struct stat st;
+    RBRoot *root = NULL;
+    Range *ranges;
+    size_t n, i;
+    void *base;
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(dump537_header))
+        return NULL;
+    if ((base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+        return NULL;
+    hdr = base;
+    rec = (const dump537_record *)(hdr + 1);
+    n = (st.st_size - sizeof(*hdr)) / sizeof(dump537_record);
+    if (memcmp(hdr->magic, DUMP537_MAGIC, sizeof(hdr->magic)) != 0 || hdr->version != DUMP537_VERSION
+        || hdr->record_size != sizeof(dump537_record)
+        || (st.st_size - sizeof(*hdr)) % sizeof(dump537_record) != 0 || n > INT32_MAX)
+    {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    if ((ranges = malloc((n ? n : 1) * sizeof(Range))) != NULL)
+    {
+        for (i = 0; i < n; i++)
+        {
+            ranges[i].start = (void *)(uintptr_t)rec[i].start;
+            ranges[i].size = rec[i].size;
+            ranges[i].freeFlag = rec[i].flags & DUMP537_LIVE ? 1 : 0;
+        }
+        root = build_rbtree(ranges, n);
+        free(ranges);
+    }
+    munmap(base, st.st_size);
+    return root;
+}
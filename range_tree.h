@@ -1,51 +1,124 @@
-#ifndef range_tree_h
-#define range_tree_h
-
-#define RED        0    // color is 0 if color is red
-#define BLACK    1    // color is 1 if color is black
-
-
-// Define Treenode
-typedef struct RBTreeNode{
-    unsigned char color;        // color is Red or Black
-    int   size;                    // address size
-    struct RBTreeNode *left;    // left children
-    struct RBTreeNode *right;    // right children
-    struct RBTreeNode *parent;    // parent
-	void *start;					
-    int freeFlag;
-
-
-}Node, *RBTree;
-
-// Define RB Tree
-typedef struct rb_root{
-    Node* node;
-}RBRoot;
-
-
-/*Define a data structure called deletelist which is to
- store all free but overlap tree nodes with the pending added treenode*/
-typedef struct delete1{
-    int cap;
-    int size;
-    Node **list;
-}delist;
-
-
-// create RB Tree
-RBRoot* create_rbtree();
-
-// Insert start pointer and address size as a node to the RB Tree
-Node* insert_rbtree(RBRoot *root, int size, void* ptr);
-
-// delete node with start pointer ptr
-void delete_rbtree(RBRoot *root, void *ptr);
-
-// search RB Tree's treenode which has start pointer ptr
-int rbtree_search(RBRoot *root, void *ptr);
-
-// print RB Tree
-void print_rbtree(RBRoot *root);
-
-#endif
+#ifndef range_tree_h
+#define range_tree_h
+#include <stddef.h>
+
+#define RED        0    // color is 0 if color is red
+#define BLACK    1    // color is 1 if color is black
+
+
+// Define Treenode
+typedef struct RBTreeNode{
+    unsigned char color;        // color is Red or Black
+    unsigned char pooled;       // 1 if the node is part of a block allocated by build_rbtree
+    unsigned char freeFlag;     // 1 if allocated, 0 if freed
+    size_t size;                   // address size
+    struct RBTreeNode *left;    // left children
+    struct RBTreeNode *right;    // right children
+    struct RBTreeNode *parent;    // parent
+	void *start;					
+    // only allocated blocks are in a malloc537 scope, so a freed block keeps its free epoch in the same bytes
+    union{
+        struct{
+            struct RBTreeNode *scope_next;     // next block of the same malloc537 scope
+            struct RBTreeNode **scope_pprev;   // link pointing at this node in its scope list, NULL if not in a scope
+        };
+        unsigned long free_epoch;   // tree epoch when the block was freed, set by the library
+    };
+    unsigned long epoch;        // tree epoch when the node was inserted
+    unsigned long max_epoch;    // largest insert epoch in the subtree of this node
+
+
+}Node, *RBTree;
+
+// Define RB Tree
+typedef struct rb_root{
+    Node* node;
+    Node* spare;                    // deleted pooled nodes, linked through left, reused by insert_rbtree
+    struct node_block *blocks;      // node blocks allocated by build_rbtree
+    unsigned long epoch;            // counts inserts and frees, a snapshot is a value of it
+}RBRoot;
+
+// one range for build_rbtree
+typedef struct rb_range{
+    void *start;
+    size_t size;
+    int freeFlag;                   // 1 if allocated, 0 if freed
+}Range;
+
+
+// filters for the cursor functions
+#define RB_LIVE     1    // allocated blocks, freeFlag 1
+#define RB_FREED    2    // freed blocks still in the tree, freeFlag 0
+#define RB_ALL      3
+
+// cursor over the blocks of a RB Tree in address order
+typedef struct rb_cursor{
+    Node *node;                     // current block, NULL once the cursor ran off either end
+    int filter;                     // RB_LIVE, RB_FREED or RB_ALL
+}RBCursor;
+
+/*Define a data structure called deletelist which is to
+ store all free but overlap tree nodes with the pending added treenode*/
+typedef struct delete1{
+    int cap;
+    int size;
+    Node **list;
+}delist;
+
+
+// create RB Tree
+RBRoot* create_rbtree();
+
+// Insert start pointer and address size as a node to the RB Tree
+Node* insert_rbtree(RBRoot *root, size_t size, void* ptr);
+
+// delete node with start pointer ptr
+void delete_rbtree(RBRoot *root, void *ptr);
+
+// search RB Tree's treenode which has start pointer ptr
+int rbtree_search(RBRoot *root, void *ptr);
+
+// print RB Tree
+void print_rbtree(RBRoot *root);
+
+// build a balanced RB Tree from n ranges sorted by start in O(n), NULL if two allocated ranges overlap
+RBRoot* build_rbtree(const Range *ranges, int n);
+
+// remove every freed node and rebalance the remaining ones in O(n)
+void rbtree_compact(RBRoot *root);
+
+// free the RB Tree and all of its nodes
+void destroy_rbtree(RBRoot *root);
+
+// first (lowest address) node of the RB Tree, NULL if the tree is empty
+Node* rbtree_first(RBRoot *root);
+
+// in-order successor of node, NULL if node is the last one
+Node* rbtree_next(Node *node);
+
+// in-order predecessor of node, NULL if node is the first one
+Node* rbtree_prev(Node *node);
+
+// put the cursor on the first block matching filter that ends at or after addr, and return it
+Node* rbcursor_seek(RBCursor *cur, RBRoot *root, void *addr, int filter);
+
+// move the cursor to the next / previous block matching its filter, and return it
+Node* rbcursor_next(RBCursor *cur);
+Node* rbcursor_prev(RBCursor *cur);
+
+// first node, in address order, inserted after epoch; subtrees with nothing newer are skipped
+Node* rbtree_first_since(RBRoot *root, unsigned long epoch);
+
+// next node after node, in address order, inserted after epoch
+Node* rbtree_next_since(Node *node, unsigned long epoch);
+
+// check the red-black and address order invariants, 0 if they hold, -1 otherwise
+int rbtree_verify(RBRoot *root);
+
+// write the tree in address order to fd in the format of dump537.h, 0 on success, -1 on error
+int rbtree_dump(RBRoot *root, int fd);
+
+// build a balanced RB Tree from a dump written by rbtree_dump, NULL if fd does not hold a valid dump
+RBRoot* load_rbtree(int fd);
+
+#endif
@@ -0,0 +1,242 @@
+/*
+ * replay537: drive the 537 library with an allocation trace recorded by a
+ * program linked against 537malloc.trace.o (see trace537.h).
+ *
+ * The trace is mapped with mmap and replayed in timestamp order. Addresses in
+ * the trace are the ones the recording process saw, so every returned pointer
+ * is remapped to the pointer the replay got for the same block, and memcheck
+ * pointers are rebuilt from the block they were recorded against.
+ *
+ * Usage: replay537 [-q] tracefile
+ *     -q    send the stdout chatter of memcheck537 to /dev/null
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "537malloc.h"
+#include "trace537.h"
+
+/*Address map from recorded pointers to replayed pointers: open addressing
+ with linear probing, deletion by backward shift so there are no tombstones*/
+typedef struct addrmap{
+    size_t cap;        // always a power of 2
+    size_t size;
+    uint64_t *key;     // 0 marks an empty slot, recorded pointers are never 0
+    void **val;
+}addrmap;
+
+static size_t map_slot(addrmap *m, uint64_t key){
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key & (m->cap - 1);
+}
+
+static void map_init(addrmap *m, size_t cap){
+    m->cap = cap;
+    m->size = 0;
+    m->key = calloc(cap, sizeof(uint64_t));
+    m->val = malloc(cap * sizeof(void *));
+    if (m->key == NULL || m->val == NULL) {
+        fprintf(stderr, "Error: no space for the address map\n");
+        exit(-1);
+    }
+}
+
+static void map_put(addrmap *m, uint64_t key, void *val);
+
+static void map_grow(addrmap *m){
+    addrmap old = *m;
+    size_t i;
+
+    map_init(m, old.cap * 2);
+    for (i = 0; i < old.cap; i++)
+        if (old.key[i] != 0)
+            map_put(m, old.key[i], old.val[i]);
+    free(old.key);
+    free(old.val);
+}
+
+static void map_put(addrmap *m, uint64_t key, void *val){
+    size_t i;
+
+    if (2 * (m->size + 1) > m->cap)
+        map_grow(m);
+    for (i = map_slot(m, key); m->key[i] != 0 && m->key[i] != key; i = (i + 1) & (m->cap - 1))
+        ;
+    if (m->key[i] == 0)
+        m->size++;
+    m->key[i] = key;
+    m->val[i] = val;
+}
+
+// return the slot holding key, or -1
+static long map_find(addrmap *m, uint64_t key){
+    size_t i;
+
+    for (i = map_slot(m, key); m->key[i] != 0; i = (i + 1) & (m->cap - 1))
+        if (m->key[i] == key)
+            return i;
+    return -1;
+}
+
+static void map_del(addrmap *m, uint64_t key){
+    long found = map_find(m, key);
+    size_t i, j, home;
+
+    if (found < 0)
+        return;
+    i = found;
+    // shift the rest of the probe run back into the hole
+    for (j = (i + 1) & (m->cap - 1); m->key[j] != 0; j = (j + 1) & (m->cap - 1)) {
+        home = map_slot(m, m->key[j]);
+        if (((j - home) & (m->cap - 1)) >= ((j - i) & (m->cap - 1))) {
+            m->key[i] = m->key[j];
+            m->val[i] = m->val[j];
+            i = j;
+        }
+    }
+    m->key[i] = 0;
+    m->size--;
+}
+
+static const trace537_event *events;
+
+// order of replay: timestamp, then position in the file
+static int by_time(const void *a, const void *b){
+    const trace537_event *x = &events[*(const size_t *)a];
+    const trace537_event *y = &events[*(const size_t *)b];
+
+    if (x->ns != y->ns)
+        return x->ns < y->ns ? -1 : 1;
+    return x < y ? -1 : x > y;
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv){
+    const trace537_header *hdr;
+    struct stat st;
+    size_t n, i, *order = NULL;
+    unsigned long unmatched = 0;
+    addrmap map;
+    void *base;
+    double t0, t1;
+    int fd, quiet = 0;
+
+    if (argc == 3 && strcmp(argv[1], "-q") == 0) {
+        quiet = 1;
+        argv++;
+        argc--;
+    }
+    if (argc != 2) {
+        fprintf(stderr, "usage: replay537 [-q] tracefile\n");
+        return 2;
+    }
+    if ((fd = open(argv[1], O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    if ((size_t)st.st_size < sizeof(trace537_header)) {
+        fprintf(stderr, "Error: %s is not an allocation trace\n", argv[1]);
+        return 1;
+    }
+    if ((base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    close(fd);
+    hdr = base;
+    if (memcmp(hdr->magic, TRACE537_MAGIC, sizeof(hdr->magic)) != 0
+        || hdr->version != TRACE537_VERSION || hdr->event_size != sizeof(trace537_event)) {
+        fprintf(stderr, "Error: %s is not a version %d allocation trace\n", argv[1], TRACE537_VERSION);
+        return 1;
+    }
+    events = (const trace537_event *)(hdr + 1);
+    n = (st.st_size - sizeof(*hdr)) / sizeof(trace537_event);
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    // single threaded traces are already in order, others get sorted once up front
+    for (i = 1; i < n && events[i - 1].ns <= events[i].ns; i++)
+        ;
+    if (i < n) {
+        if ((order = malloc(n * sizeof(size_t))) == NULL) {
+            fprintf(stderr, "Error: no space to sort the trace\n");
+            return 1;
+        }
+        for (i = 0; i < n; i++)
+            order[i] = i;
+        qsort(order, n, sizeof(size_t), by_time);
+    }
+    if (quiet && freopen("/dev/null", "w", stdout) == NULL)
+        perror("/dev/null");
+
+    map_init(&map, 1024);
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        const trace537_event *e = &events[order ? order[i] : i];
+        long slot;
+        void *p;
+
+        switch (e->op) {
+        case TRACE537_MALLOC:
+            map_put(&map, e->ret, malloc537(e->size));
+            break;
+        case TRACE537_CALLOC:
+            map_put(&map, e->ret, calloc537(1, e->size));
+            break;
+        case TRACE537_ALIGNED:
+            map_put(&map, e->ret, aligned_alloc537(e->ptr, e->size));
+            break;
+        case TRACE537_FREE:
+            if ((slot = map_find(&map, e->ptr)) < 0) {
+                unmatched++;
+                break;
+            }
+            p = map.val[slot];
+            map_del(&map, e->ptr);
+            free537(p);
+            break;
+        case TRACE537_REALLOC:
+            if ((slot = map_find(&map, e->ptr)) < 0) {
+                unmatched++;
+                break;
+            }
+            p = map.val[slot];
+            map_del(&map, e->ptr);
+            p = realloc537(p, e->size);
+            if (e->ret != 0)
+                map_put(&map, e->ret, p);
+            break;
+        case TRACE537_MEMCHECK:
+            if ((slot = map_find(&map, e->ret)) < 0) {
+                unmatched++;
+                break;
+            }
+            memcheck537((char *)map.val[slot] + (e->ptr - e->ret), e->size);
+            break;
+        default:
+            fprintf(stderr, "Error: unknown operation %d in event %zu\n", e->op, i);
+            return 1;
+        }
+    }
+    t1 = now();
+
+    fprintf(stderr, "replayed %zu events in %.3f s, %.1f ns/event", n, t1 - t0,
+        n ? (t1 - t0) * 1e9 / n : 0.0);
+    if (unmatched)
+        fprintf(stderr, ", %lu events skipped (pointer not in the trace)", unmatched);
+    fprintf(stderr, "\n");
+    return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Size-class slab allocator with inline block headers, see slab537.h
+ *
+ * A slab is a 64KB region aligned to 64KB. It starts with a struct slab and
+ * is followed by equal blocks of one size class, each a 16 byte header and
+ * the user bytes. Blocks are handed out in address order the first time and
+ * from a per class free list after that. Slabs are cut out of arenas of
+ * several slabs, so the alignment slack of one allocation is shared by all of
+ * them. Slabs are never given back.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "slab537.h"
+
+#define SLAB_SIZE  (64 * 1024)
+#define SLAB_MAGIC 0x35333773       // "s735"
+
+// slabs per arena: the first arena is small, every next one twice as big up to ARENA_MAX
+#define ARENA_MIN  4
+#define ARENA_MAX  64
+
+// block states kept in the header
+#define BLOCK_LIVE 0x4c31
+#define BLOCK_FREE 0x4630
+
+// size classes, every one a multiple of 16 so user pointers are 16 byte aligned
+static const uint32_t classSize[] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024 };
+#define NCLASSES ((int)(sizeof(classSize) / sizeof(classSize[0])))
+
+typedef struct slab{
+    uint32_t magic;
+    uint32_t cls;                   // size class of the blocks
+    uint32_t stride;                // header plus class size
+    uint32_t nblocks;               // blocks that fit in the slab
+    uint32_t used;                  // blocks handed out at least once
+    struct slab *next;              // list of all slabs
+    char *data;                     // first block
+}slab;
+
+typedef struct blockhdr{
+    uint32_t size;                  // size asked for
+    uint16_t state;                 // BLOCK_LIVE or BLOCK_FREE
+    uint16_t check;                 // checksum of the address, size and state
+    struct blockhdr *next;          // free list link while the block is freed
+}blockhdr;
+
+static blockhdr *freelist[NCLASSES];
+static slab *current[NCLASSES];     // slab the next new block of a class comes from
+static slab *slabs;
+
+// free part of the current arena
+static char *arenaNext, *arenaEnd;
+static size_t arenaSlabs = ARENA_MIN;
+
+/*Set of slab addresses: open addressing with linear probing. It tells
+ whether a masked pointer really is a slab before anything is read there.*/
+static uintptr_t *table;
+static size_t tableCap, tableSize;
+
+static size_t slot_of(uintptr_t key){
+    uint64_t x = key / SLAB_SIZE;
+    x *= 0x9e3779b97f4a7c15ULL;
+    return (x >> 32) & (tableCap - 1);
+}
+
+static int table_has(uintptr_t key){
+    size_t i;
+
+    if (tableCap == 0)
+        return 0;
+    for (i = slot_of(key); table[i] != 0; i = (i + 1) & (tableCap - 1))
+        if (table[i] == key)
+            return 1;
+    return 0;
+}
+
+static int table_add(uintptr_t key){
+    size_t i;
+
+    if (2 * (tableSize + 1) > tableCap) {
+        uintptr_t *old = table;
+        size_t oldCap = tableCap;
+        size_t cap = oldCap ? 2 * oldCap : 64;
+
+        if ((table = calloc(cap, sizeof(uintptr_t))) == NULL) {
+            table = old;
+            return -1;
+        }
+        tableCap = cap;
+        for (i = 0; i < oldCap; i++)
+            if (old[i] != 0) {
+                size_t j;
+                for (j = slot_of(old[i]); table[j] != 0; j = (j + 1) & (tableCap - 1))
+                    ;
+                table[j] = old[i];
+            }
+        free(old);
+    }
+    for (i = slot_of(key); table[i] != 0; i = (i + 1) & (tableCap - 1))
+        ;
+    table[i] = key;
+    tableSize++;
+    return 0;
+}
+
+static uint16_t checksum(const blockhdr *h){
+    uint64_t x = (uintptr_t)h ^ ((uint64_t)h->size << 24) ^ ((uint64_t)h->state << 48) ^ 0x2545f4914f6cdd1dULL;
+
+    x ^= x >> 29;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 32;
+    return (uint16_t)(x ^ (x >> 16));
+}
+
+static void set_state(blockhdr *h, size_t size, int state){
+    h->size = size;
+    h->state = state;
+    h->check = checksum(h);
+}
+
+static int class_of(size_t size){
+    int c = 0;
+
+    while (classSize[c] < size)
+        c++;
+    return c;
+}
+
+/*The next free slab of the current arena, starting a new arena when it is
+ used up. A single 64KB aligned slab would cost glibc a mapping of its own
+ plus as much alignment slack again; an arena pays that slack once.*/
+static void* slab_memory(void){
+    void *p;
+
+    if (arenaNext == arenaEnd) {
+        if (posix_memalign(&p, SLAB_SIZE, arenaSlabs * SLAB_SIZE) != 0)
+            return NULL;
+        arenaNext = p;
+        arenaEnd = arenaNext + arenaSlabs * SLAB_SIZE;
+        if (arenaSlabs < ARENA_MAX)
+            arenaSlabs *= 2;
+    }
+    p = arenaNext;
+    arenaNext += SLAB_SIZE;
+    return p;
+}
+
+static slab* new_slab(int c){
+    slab *s;
+    void *p;
+
+    if ((p = slab_memory()) == NULL)
+        return NULL;
+    if (table_add((uintptr_t)p) < 0) {
+        arenaNext -= SLAB_SIZE;     // give it back to the arena
+        return NULL;
+    }
+    s = p;
+    s->magic = SLAB_MAGIC;
+    s->cls = c;
+    s->stride = sizeof(blockhdr) + classSize[c];
+    s->data = (char *)p + ((sizeof(slab) + 15) & ~(size_t)15);
+    s->nblocks = ((char *)p + SLAB_SIZE - s->data) / s->stride;
+    s->used = 0;
+    s->next = slabs;
+    slabs = s;
+    current[c] = s;
+    return s;
+}
+
+void *slab_alloc(size_t size){
+    int c = class_of(size);
+    blockhdr *h;
+    slab *s;
+
+    if ((h = freelist[c]) != NULL) {
+        freelist[c] = h->next;
+    } else {
+        if ((s = current[c]) == NULL || s->used == s->nblocks)
+            if ((s = new_slab(c)) == NULL)
+                return NULL;
+        h = (blockhdr *)(s->data + (size_t)s->used++ * s->stride);
+    }
+    set_state(h, size, BLOCK_LIVE);
+    return h + 1;
+}
+
+int slab_lookup(void *ptr, SlabBlock *blk){
+    uintptr_t base = (uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1);
+    slab *s = (slab *)base;
+    blockhdr *h;
+    size_t i;
+
+    if (!table_has(base) || (char *)ptr < s->data)
+        return SLAB_NONE;
+    if ((i = ((char *)ptr - s->data) / s->stride) >= s->used)
+        return SLAB_NONE;
+    h = (blockhdr *)(s->data + i * s->stride);
+    blk->start = h + 1;
+    blk->size = h->size;
+    if (h->check != checksum(h) || (h->state != BLOCK_LIVE && h->state != BLOCK_FREE))
+        return SLAB_CORRUPT;
+    // the header itself and the slack after the block belong to no block; a 0 byte block matches its start only
+    if ((char *)ptr < (char *)blk->start || (char *)ptr >= (char *)blk->start + (h->size ? h->size : 1))
+        return SLAB_NONE;
+    return h->state == BLOCK_LIVE ? SLAB_LIVE : SLAB_FREED;
+}
+
+void slab_free(void *start){
+    blockhdr *h = (blockhdr *)start - 1;
+    slab *s = (slab *)((uintptr_t)h & ~(uintptr_t)(SLAB_SIZE - 1));
+
+    set_state(h, h->size, BLOCK_FREE);
+    h->next = freelist[s->cls];
+    freelist[s->cls] = h;
+}
+
+void slab_walk(void (*fn)(void *start, size_t size, void *arg), void *arg){
+    slab *s;
+    uint32_t i;
+
+    for (s = slabs; s != NULL; s = s->next)
+        for (i = 0; i < s->used; i++) {
+            blockhdr *h = (blockhdr *)(s->data + (size_t)i * s->stride);
+            if (h->state == BLOCK_LIVE && h->check == checksum(h))
+                fn(h + 1, h->size, arg);
+        }
+}
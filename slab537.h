@@ -0,0 +1,39 @@
+#ifndef slab537_h
+#define slab537_h
+#include <stddef.h>
+
+/*Size-class slab allocator used by 537malloc.c when it is built with
+ -DSLAB537. Small blocks are carved out of 64KB slabs, one size class per
+ slab, taken from arenas of up to 64 slabs; every block starts with a 16 byte header holding its size, its
+ state and a checksum. Any pointer is mapped to its slab with a mask and a
+ hash lookup, and to its block with a division, so every check is O(1)
+ and the range tree only holds the blocks bigger than SLAB_MAX.*/
+
+// largest block served from the slabs
+#define SLAB_MAX 1024
+
+// results of slab_lookup
+#define SLAB_NONE     0     // ptr is in no block that was ever handed out
+#define SLAB_LIVE     1     // ptr is in an allocated block
+#define SLAB_FREED    2     // ptr is in a freed block
+#define SLAB_CORRUPT  3     // the header of the block holding ptr has been overwritten
+
+// the block slab_lookup found
+typedef struct slab_block{
+    void *start;            // first byte of the block
+    size_t size;            // size asked for when it was allocated
+}SlabBlock;
+
+// allocate size bytes, size at most SLAB_MAX, NULL if there is no memory
+void *slab_alloc(size_t size);
+
+// find the block holding ptr, fill blk and return one of the SLAB_ results; a 0 byte block is found by its start only
+int slab_lookup(void *ptr, SlabBlock *blk);
+
+// free an allocated block, start must be the start slab_lookup returned
+void slab_free(void *start);
+
+// call fn for every allocated block
+void slab_walk(void (*fn)(void *start, size_t size, void *arg), void *arg);
+
+#endif
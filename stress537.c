@@ -0,0 +1,315 @@
+/*
+ * stress537: randomized differential stress driver for range_tree.c
+ *
+ * Runs a long random sequence of operations against the range tree and
+ * against a plain sorted array of intervals that follows the same rules:
+ *     alloc     insert a range that overlaps no live range
+ *     free      turn a live range into a tombstone (freeFlag 0)
+ *     reuse     insert a range over one or more tombstones, which go through
+ *               nodeoverlap: tombstones starting inside the new range are
+ *               deleted, the ones starting before it are shrunk
+ *     lookup    find the range holding a random address, and seek a cursor to it
+ *     compact   drop all tombstones with rbtree_compact (rare)
+ *     rebuild   replace the tree with build_rbtree from the reference (rare)
+ * The ranges live in a made up address window and never touch real memory.
+ *
+ * Debug builds (stress537) check the red-black invariants and compare the
+ * whole tree with the array after every step. Release builds (-DNDEBUG,
+ * stress537-opt) only compare at the end and report the throughput of
+ * every operation, timing the tree calls alone. make stress builds both.
+ *
+ * Usage: stress537 [-s seed] [-n steps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "range_tree.h"
+
+// made up address window the ranges live in, start and size are drawn from it
+#define WINDOW_BASE 0x10000000UL
+#define WINDOW_SIZE (1UL << 20)
+#define MAXSIZE 256
+
+// the per step checks of debug builds are O(n), so they run fewer steps by default
+#ifdef NDEBUG
+#define STEPS 1000000
+#else
+#define STEPS 100000
+#endif
+
+enum { ALLOC, FREE, REUSE, LOOKUP, COMPACT, REBUILD, NOPS };
+static const char *opname[NOPS] = { "alloc", "free", "reuse", "lookup", "compact", "rebuild" };
+
+/*Reference interval set: sorted by start, ranges never overlap*/
+typedef struct interval{
+    uintptr_t start;
+    uintptr_t size;
+    int live;
+}interval;
+
+static interval *ref;
+static size_t nref, capref;
+
+static uint64_t rng;
+
+static uint64_t xorshift(void){
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static uintptr_t pick(uintptr_t n){
+    return xorshift() % n;
+}
+
+// index of the first interval that ends at or after addr
+static size_t ref_lower(uintptr_t addr){
+    size_t lo = 0, hi = nref;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (ref[mid].start + ref[mid].size - 1 < addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// 1 if [start, start+size) overlaps a live interval
+static int ref_hits_live(uintptr_t start, uintptr_t size){
+    size_t i;
+
+    for (i = ref_lower(start); i < nref && ref[i].start < start + size; i++)
+        if (ref[i].live)
+            return 1;
+    return 0;
+}
+
+// the same rules as rbtree_insert and nodeoverlap
+static void ref_insert(uintptr_t start, uintptr_t size){
+    size_t i = ref_lower(start), j;
+
+    // a tombstone starting before the new range keeps only the part in front of it
+    if (i < nref && ref[i].start < start) {
+        ref[i].size = start - ref[i].start;
+        i++;
+    }
+    // tombstones starting inside the new range are deleted
+    for (j = i; j < nref && ref[j].start < start + size; j++)
+        ;
+    if (nref - (j - i) + 1 > capref) {
+        capref = capref ? 2 * capref : 1024;
+        ref = realloc(ref, capref * sizeof(interval));
+    }
+    memmove(&ref[i + 1], &ref[j], (nref - j) * sizeof(interval));
+    nref = nref - (j - i) + 1;
+    ref[i].start = start;
+    ref[i].size = size;
+    ref[i].live = 1;
+}
+
+// tree node holding addr, found the way free537 and memcheck537 do
+static Node* tree_find(RBRoot *root, void *addr){
+    Node *node = root->node;
+
+    while (node != NULL) {
+        if (addr < node->start)
+            node = node->left;
+        else if (addr > node->start + node->size - 1)
+            node = node->right;
+        else
+            return node;
+    }
+    return NULL;
+}
+
+static void fail(uint64_t seed, unsigned long step, const char *what){
+    fprintf(stderr, "stress537: step %lu (seed %llu): %s\n", step, (unsigned long long)seed, what);
+    exit(1);
+}
+
+// compare the whole tree with the reference
+static void compare(RBRoot *root, uint64_t seed, unsigned long step){
+    Node *node = rbtree_first(root);
+    size_t i;
+
+    for (i = 0; i < nref; i++, node = rbtree_next(node)) {
+        if (node == NULL)
+            fail(seed, step, "tree has fewer ranges than the reference");
+        if ((uintptr_t)node->start != ref[i].start || (uintptr_t)node->size != ref[i].size
+            || node->freeFlag != ref[i].live) {
+            fprintf(stderr, "tree %p+%zu live %d, reference %#lx+%lu live %d\n", node->start,
+                node->size, node->freeFlag, (unsigned long)ref[i].start,
+                (unsigned long)ref[i].size, ref[i].live);
+            fail(seed, step, "tree and reference differ");
+        }
+    }
+    if (node != NULL)
+        fail(seed, step, "tree has more ranges than the reference");
+}
+
+static inline uint64_t now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv){
+    uint64_t seed = time(NULL), t;
+    uint64_t ns[NOPS] = {0};
+    unsigned long count[NOPS] = {0};
+    unsigned long steps = STEPS, step;
+    RBRoot *root;
+    RBCursor cur;
+    Range *ranges = NULL;
+    size_t caprange = 0;
+    int opt, op;
+
+    while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+        switch (opt) {
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'n':
+            steps = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: stress537 [-s seed] [-n steps]\n");
+            return 2;
+        }
+    }
+    rng = seed * 2654435761ULL + 1;
+    root = create_rbtree();
+
+    for (step = 0; step < steps; step++) {
+        uintptr_t start = 0, size = 0, addr;
+        size_t i, j;
+        Node *node = NULL;
+
+        // the O(n) whole tree operations are rare
+        op = pick(1000) == 0 ? COMPACT + pick(2) : pick(LOOKUP + 1);
+        switch (op) {
+        case ALLOC:
+            start = WINDOW_BASE + pick(WINDOW_SIZE - MAXSIZE);
+            size = 1 + pick(MAXSIZE);
+            if (ref_hits_live(start, size))
+                continue;
+            break;
+        case FREE:
+        case REUSE:
+            // a random live range to free, or a random tombstone to build over
+            if (nref == 0)
+                continue;
+            for (i = pick(nref); i < nref && ref[i].live != (op == FREE); i++)
+                ;
+            if (i == nref)
+                continue;
+            if (op == FREE) {
+                start = ref[i].start;
+                break;
+            }
+            // start in the tombstone, reach up to the next live range
+            start = ref[i].start + pick(ref[i].size);
+            size = 1 + pick(MAXSIZE * 2);
+            while (++i < nref && !ref[i].live)
+                ;
+            if (i < nref && start + size > ref[i].start)
+                size = ref[i].start - start;
+            break;
+        case LOOKUP:
+            start = WINDOW_BASE + pick(WINDOW_SIZE);
+            break;
+        case REBUILD:
+            if (nref > caprange) {
+                caprange = nref;
+                ranges = realloc(ranges, caprange * sizeof(Range));
+            }
+            for (i = 0; i < nref; i++) {
+                ranges[i].start = (void *)ref[i].start;
+                ranges[i].size = ref[i].size;
+                ranges[i].freeFlag = ref[i].live;
+            }
+            break;
+        }
+
+        addr = start;
+        t = now();
+        switch (op) {
+        case ALLOC:
+        case REUSE:
+            node = insert_rbtree(root, size, (void *)addr);
+            break;
+        case FREE:
+            node = tree_find(root, (void *)addr);
+            if (node != NULL)
+                node->freeFlag = 0;
+            break;
+        case LOOKUP:
+            node = tree_find(root, (void *)addr);
+            rbcursor_seek(&cur, root, (void *)addr, RB_ALL);
+            break;
+        case COMPACT:
+            rbtree_compact(root);
+            break;
+        case REBUILD:
+            destroy_rbtree(root);
+            if ((root = build_rbtree(ranges, nref)) == NULL)
+                fail(seed, step, "build_rbtree rejected the reference ranges");
+            break;
+        }
+        ns[op] += now() - t;
+        count[op]++;
+
+        switch (op) {
+        case ALLOC:
+        case REUSE:
+            ref_insert(addr, size);
+            break;
+        case FREE:
+            i = ref_lower(addr);
+            if (node == NULL || (uintptr_t)node->start != addr)
+                fail(seed, step, "live range to free is not in the tree");
+            ref[i].live = 0;
+            break;
+        case COMPACT:
+            for (i = 0, j = 0; i < nref; i++)
+                if (ref[i].live)
+                    ref[j++] = ref[i];
+            nref = j;
+            break;
+        case LOOKUP:
+            i = ref_lower(addr);
+            if (i < nref && ref[i].start <= addr) {
+                if (node == NULL || (uintptr_t)node->start != ref[i].start)
+                    fail(seed, step, "lookup missed a range of the reference");
+            } else if (node != NULL) {
+                fail(seed, step, "lookup found a range that is not in the reference");
+            }
+            if (i < nref ? cur.node == NULL || (uintptr_t)cur.node->start != ref[i].start : cur.node != NULL)
+                fail(seed, step, "cursor seek stopped at the wrong range");
+            break;
+        }
+
+#ifndef NDEBUG
+        if (rbtree_verify(root) < 0)
+            fail(seed, step, "red-black invariants broken");
+        compare(root, seed, step);
+#endif
+    }
+    if (rbtree_verify(root) < 0)
+        fail(seed, step, "red-black invariants broken");
+    compare(root, seed, step);
+
+    printf("stress537: seed %llu, %lu steps, %zu ranges at the end\n", (unsigned long long)seed, steps, nref);
+    for (op = 0; op < NOPS; op++)
+        if (count[op])
+            printf("    %-7s %9lu ops %8.1f ns/op %8.2f Mops/s\n", opname[op], count[op],
+                (double)ns[op] / count[op], ns[op] ? count[op] * 1e3 / ns[op] : 0.0);
+    return 0;
+}
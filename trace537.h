@@ -0,0 +1,39 @@
+#ifndef trace537_h
+#define trace537_h
+#include <stdint.h>
+
+/*Binary allocation trace written by 537malloc.c when it is built with
+ -DTRACE537 and the MALLOC537_TRACE environment variable names the output
+ file. The file is a trace537_header followed by fixed-width
+ trace537_event records. Each thread fills its own buffer and appends it to
+ the file as a whole, so the records of different threads come in chunks and
+ are only ordered by their timestamps. replay537 reads this format.*/
+
+#define TRACE537_MAGIC   "537TRACE"
+#define TRACE537_VERSION 1
+
+// operations recorded in trace537_event.op
+#define TRACE537_MALLOC   1    // ret = malloc537(size)
+#define TRACE537_FREE     2    // free537(ptr)
+#define TRACE537_REALLOC  3    // ret = realloc537(ptr, size)
+#define TRACE537_MEMCHECK 4    // memcheck537(ptr, size), ret is the start of the block holding ptr
+#define TRACE537_CALLOC   5    // ret = calloc537(1, size), size is the product of the arguments
+#define TRACE537_ALIGNED  6    // ret = aligned_alloc537(ptr, size), ptr is the alignment
+
+typedef struct trace537_header{
+    char     magic[8];        // TRACE537_MAGIC, not NUL terminated
+    uint32_t version;         // TRACE537_VERSION
+    uint32_t event_size;      // sizeof(trace537_event)
+}trace537_header;
+
+typedef struct trace537_event{
+    uint8_t  op;              // one of the TRACE537_ operations
+    uint8_t  pad[3];
+    uint32_t thread;          // small per-process thread number, starting at 0
+    uint64_t ptr;             // pointer argument, or the alignment of TRACE537_ALIGNED
+    uint64_t ret;             // returned pointer
+    uint64_t size;            // size argument
+    uint64_t ns;              // CLOCK_MONOTONIC time in nanoseconds
+}trace537_event;
+
+#endif